@@ -1,6 +1,18 @@
 /*
    The buffer is a class than handles all data regarding the inkjet. It takes burst and position information and stores it in a FiFo buffer. The buffer is what takes the most memory on the microcontroller
 
+   The buffer can be split in up to 8 equal slots, each holding its own image with its own length and mode. All reading and writing
+   happens within the selected slot, so switching between images that were uploaded before only swaps a few values.
+
+   With compression on, a line only holds its position and the number of its burst. Bursts are kept in a separate pool, and a line
+   with the same burst as the line before it uses the same burst, so blank and repeated lines take 6 bytes instead of 48.
+   The same memory then holds 4 times the lines, but only about half the different bursts. The pool is filled in order and freed
+   in order, just like the lines. Bursts are only looked up for the current line in GetBurst().
+
+   With a repeat pitch set in looping mode, the image is a pattern that is stepped and repeated: after the last line each side
+   goes on with line 1, with all positions moved by one more pitch. The sides wrap on their own, without a reset or a trigger,
+   so there is no gap between repeats. With a repeat count set, the sides stop after that many patterns.
+
    Todo:
    - Do not meticulously calculate buffer read and write left, but simply hold a variable that keeps this data. It will not magically add 15 lines without the functions knowing about it.
 */
@@ -9,6 +21,10 @@
 #include "Buffer.h" //<*whispers: "there is actually nothing in there"
 
 #define BUFFER_SIZE 4003 //the number of 48 byte blocks the buffer consists of (44 for inkjet, 4 for coordinate) (+3 for off by ones)
+#define BUFFER_SLOTS 8 //the most slots the buffer can be split in
+#define BUFFER_COMPRESSION_OFF 0 //every line holds its own burst
+#define BUFFER_COMPRESSION_REPEAT 1 //lines refer to a burst in the pool, repeated bursts are stored once
+#define BUFFER_COMPRESSION_LINES 4 //how many times the lines fit in the same memory with compression on
 #define PRIMITIVE_OVERLAY_EVEN 7384 //B0001110011011000 
 #define PRIMITIVE_OVERLAY_ODD 8999  //B0010001100100111
 
@@ -22,8 +38,7 @@
 
 class Buffer {
     //class member variables
-    uint16_t burstBuffer[BUFFER_SIZE][22]; //burst data
-    int32_t positionBuffer[BUFFER_SIZE]; //position data
+    uint32_t bufferMemory[BUFFER_SIZE * 12]; //all burst and position data, 48 bytes (12 words) per line, laid out per slot
     int32_t readPosition[2], writePosition; //read and write positions for odd and even
     uint16_t primitiveOverlay[2]; //0 or 1 for even or odd
     //int32_t readLeft[2], writeLeft; //future additions
@@ -31,6 +46,27 @@ class Buffer {
     uint8_t bufferMode = BUFFER_MODE_CLEARING;
     uint8_t bufferPrintMode = BUFFER_PRINT_MODE_ALL;
     uint8_t bufferLoopCounter = 0; //contains how often the buffer has looped. Is used to activate other functions
+    uint16_t (*slotBurst)[22]; //burst data of the selected slot (per line, or the pool with compression on)
+    int32_t *slotPosition; //position data of the selected slot
+    uint16_t *slotBurstNumber = 0; //the burst in the pool of each line, only with compression on
+    int32_t slotSize = BUFFER_SIZE; //the number of lines in each slot
+    int32_t slotWords = BUFFER_SIZE * 12; //the memory of each slot in words
+    uint8_t slotCount = 1;
+    uint8_t slotActive = 0;
+    int32_t slotWritePosition[BUFFER_SLOTS]; //the write positions of the slots that are not selected
+    uint8_t slotMode[BUFFER_SLOTS]; //the modes of the slots that are not selected
+    uint8_t bufferCompression = BUFFER_COMPRESSION_OFF;
+    int32_t poolSize = 0; //the number of bursts in the pool of each slot
+    int32_t poolWrite = 1; //where the next new burst goes in the pool
+    int32_t poolLast = 0; //the burst of the last written line
+    int32_t slotPoolWrite[BUFFER_SLOTS]; //the pool positions of the slots that are not selected
+    int32_t slotPoolLast[BUFFER_SLOTS];
+    int32_t repeatPitch = 0; //distance in microns between repeats of the pattern in looping mode, 0 is off
+    uint32_t repeatCount = 0; //how many times the pattern is printed, 0 is endless
+    uint32_t repeatIndex[2] = {0, 0}; //which repeat each side is on
+    int32_t extentMin, extentMax; //the lowest and highest line position written to the selected slot since it was cleared
+    int32_t slotExtentMin[BUFFER_SLOTS]; //the extents of the slots that are not selected
+    int32_t slotExtentMax[BUFFER_SLOTS];
 
   public:
     Buffer() {
@@ -38,7 +74,7 @@ class Buffer {
       primitiveOverlay[0] = PRIMITIVE_OVERLAY_ODD;
       primitiveOverlay[1] = PRIMITIVE_OVERLAY_EVEN;
 
-      ClearAll(); //reset the buffer
+      SetSlots(1); //reset the buffer, as one slot
     }
     void SetMode(uint8_t tempMode) { //sets the mode the buffer operates at
       if (tempMode == BUFFER_MODE_CLEARING || tempMode == BUFFER_MODE_STATIC || tempMode == BUFFER_MODE_LOOPING) { //verify if the requested value is valid
@@ -52,11 +88,17 @@ class Buffer {
       tempSide &= 1; //constrain side
       
       if (ReadLeftSide(tempSide) > 0) { //if there is something left to read
-        readPosition[tempSide] ++; //add one to the read position
-        readPosition[tempSide] = readPosition[tempSide] % BUFFER_SIZE; //overflow protection
+        if (RepeatActive() == 1 && readPosition[tempSide] == writePosition - 1) { //end of the pattern, go on with the first line of the next repeat
+          readPosition[tempSide] = 1;
+          repeatIndex[tempSide]++;
+        }
+        else {
+          readPosition[tempSide] ++; //add one to the read position
+          readPosition[tempSide] = readPosition[tempSide] % slotSize; //overflow protection
+        }
         //Serial.print("Buffer next side: "); Serial.print(tempSide);  Serial.print(", left: "); Serial.println(ReadLeftSide(tempSide));
 
-        if (bufferMode == BUFFER_MODE_LOOPING ) { //if the mode is looping
+        if (bufferMode == BUFFER_MODE_LOOPING && repeatPitch == 0) { //if the mode is looping (repeats never reset)
           if (ReadLeft() == 0) { //if there is nothing left to read on either side
             Reset(); //reset the buffer
             //Serial.println("Loop: Resetting buffer");
@@ -71,25 +113,34 @@ class Buffer {
       tempSide &= 1; //constrain side
       int32_t tempReadPos;
       if (ReadLeftSide(tempSide) > 0) { //if there is something left ot read
+        if (RepeatActive() == 1 && readPosition[tempSide] == writePosition - 1) { //the next line is the first of the next repeat
+          return slotPosition[1] + int32_t(repeatIndex[tempSide] + 1) * repeatPitch;
+        }
         tempReadPos = readPosition[tempSide]; //make a temporary read position and make it go to the next pos
         tempReadPos ++;
-        tempReadPos = tempReadPos % BUFFER_SIZE; //overflow protection
-        return positionBuffer[tempReadPos];
+        tempReadPos = tempReadPos % slotSize; //overflow protection
+        return slotPosition[tempReadPos] + int32_t(repeatIndex[tempSide]) * repeatPitch;
       }
       return -1; //return -1 for error
     }
     int32_t Add(int32_t temp_position, uint16_t tempInput[22]) { //adds a coordinate (int32_t and a burst to the buffer, returns space left if successful, -1 if failed
       int32_t temp_left = WriteLeft();
       if (temp_left > 0) { //if there is space left in the buffer
-        positionBuffer[writePosition] = temp_position; //add position
+        slotPosition[writePosition] = temp_position; //add position
+        AddExtent(temp_position);
         //Serial.print("Add to buffer: "); Serial.print(temp_position); Serial.print(": ");
-        for (uint8_t a = 0; a < 22; a++) { //add burst
-          burstBuffer[writePosition][a] = tempInput[a];
-          //Serial.print(tempInput[a]); Serial.print(", ");
+        if (slotBurstNumber != 0) { //compression on, add to pool
+          PoolAdd(tempInput);
+        }
+        else {
+          for (uint8_t a = 0; a < 22; a++) { //add burst
+            slotBurst[writePosition][a] = tempInput[a];
+            //Serial.print(tempInput[a]); Serial.print(", ");
+          }
         }
         //Serial.println("");
         writePosition++; //add one to write position
-        writePosition = writePosition % BUFFER_SIZE; //overflow protection
+        writePosition = writePosition % slotSize; //overflow protection
         temp_left--;
         //Serial.print("Buffer write left: "); Serial.println(temp_left);
         //Serial.print("Buffer read left: "); Serial.println(ReadLeft());
@@ -97,16 +148,37 @@ class Buffer {
       }
       return -1; //return a -1 if this failed
     }
+    int32_t AddBulk(const uint8_t *tempLines, int32_t tempCount) { //adds packed lines (position, 4 bytes, then burst, 44 bytes) until the buffer is full, returns the number of lines added
+      int32_t tempLeft = WriteLeft();
+      if (tempCount > tempLeft) tempCount = tempLeft;
+      if (tempCount < 0) tempCount = 0;
+      for (int32_t l = 0; l < tempCount; l++) {
+        memcpy(&slotPosition[writePosition], tempLines, 4);
+        AddExtent(slotPosition[writePosition]);
+        if (slotBurstNumber != 0) { //compression on, add to pool
+          uint16_t tempBurst[22];
+          memcpy(tempBurst, tempLines + 4, 44);
+          PoolAdd(tempBurst);
+        }
+        else {
+          memcpy(slotBurst[writePosition], tempLines + 4, 44);
+        }
+        tempLines += 48;
+        writePosition++;
+        if (writePosition >= slotSize) writePosition = 0; //overflow protection
+      }
+      return tempCount;
+    }
     int32_t ReadLeft() { //returns the number of filled buffer read slots. Automatically returns the largest value
       //calculate read lines left on pos 0 by subtracting read position and adding write position, and then take the modulo of the buffer size to protect from overflows
       int32_t tempCalc1, tempCalc2;
-      tempCalc1 = BUFFER_SIZE;
+      tempCalc1 = slotSize;
       tempCalc1 += writePosition;
       tempCalc2 = tempCalc1;
       tempCalc1 -= readPosition[0];
       tempCalc2 -= readPosition[1];
-      tempCalc1 = tempCalc1 % BUFFER_SIZE; //constrain to buffer size
-      tempCalc2 = tempCalc2 % BUFFER_SIZE;
+      tempCalc1 = tempCalc1 % slotSize; //constrain to buffer size
+      tempCalc2 = tempCalc2 % slotSize;
       tempCalc1 -= 1; //subtract one because read can never be equal to write
       tempCalc2 -= 1;
       if (tempCalc1 > tempCalc2) { //return smallest value
@@ -119,24 +191,36 @@ class Buffer {
     int32_t ReadLeftSide(uint8_t tempSide) {//returns the number of lines left to read for a given size
       tempSide &= 1; //constrain side
       int32_t tempCalc;
-      tempCalc = BUFFER_SIZE;
+      tempCalc = slotSize;
       tempCalc += writePosition;
       tempCalc -= readPosition[tempSide];
-      tempCalc = tempCalc % BUFFER_SIZE; //constrain to buffer size
+      tempCalc = tempCalc % slotSize; //constrain to buffer size
       tempCalc -= 1; //subtract one because read can never be equal to write
+      if (RepeatActive() == 1) { //add the lines of the repeats still to come
+        if (repeatCount == 0) tempCalc += writePosition - 1; //endless, there is always at least one more pattern
+        else if (repeatIndex[tempSide] + 1 < repeatCount) tempCalc += (repeatCount - 1 - repeatIndex[tempSide]) * (writePosition - 1);
+      }
       return tempCalc;
     }
-    int32_t WriteLeft() { //returns the number of free buffer write slots. Automatically returns the smallest value
+    int32_t WriteLeft() { //returns the number of free buffer write slots. With compression on, no more than the free bursts in the pool
+      int32_t tempLeft = WriteLeftLines();
+      if (slotBurstNumber != 0) {
+        int32_t tempPool = PoolLeft();
+        if (tempPool < tempLeft) tempLeft = tempPool;
+      }
+      return tempLeft;
+    }
+    int32_t WriteLeftLines() { //returns the number of free buffer write slots. Automatically returns the smallest value
       //calculate write lines left on pos 0 by subtracting write position and adding read position, and then take the modulo of the buffer size to protect from overflows
       int32_t tempCalc1, tempCalc2;
       if (bufferMode == BUFFER_MODE_CLEARING) { //if the buffer is cleared after a line is printed, calculate rolling value
-        tempCalc1 = BUFFER_SIZE;
+        tempCalc1 = slotSize;
         tempCalc1 -= writePosition;
         tempCalc2 = tempCalc1;
         tempCalc1 += readPosition[0];
         tempCalc2 += readPosition[1];
-        tempCalc1 = tempCalc1 % BUFFER_SIZE; //constrain to buffer size
-        tempCalc2 = tempCalc2 % BUFFER_SIZE;
+        tempCalc1 = tempCalc1 % slotSize; //constrain to buffer size
+        tempCalc2 = tempCalc2 % slotSize;
         tempCalc1 -= 2; //subtract to create some protection
         tempCalc2 -= 2;
         if (tempCalc1 < tempCalc2) { //return smallest value
@@ -147,33 +231,156 @@ class Buffer {
         }
       }
       if (bufferMode == BUFFER_MODE_STATIC  || bufferMode == BUFFER_MODE_LOOPING) { //if the line is retained after it is printed
-        tempCalc1 = BUFFER_SIZE; //start with the buffer size
+        tempCalc1 = slotSize; //start with the buffer size
         tempCalc1 -= writePosition; //subtract where we are currently writing
         tempCalc1 -= 2; //subtract to create some protection
         return tempCalc1;
       }
       return 0; //if you got here, something went horribly wrong
     }
-    void ClearAll() { //resets the read and write positions in the buffer
-      for (uint16_t b = 0; b < BUFFER_SIZE; b++) {
-        for (uint8_t a = 0; a < 22; a++) {
-          burstBuffer[b][a] = 0;
-        }
-        positionBuffer[b] = 0;
-      }
+    void ClearAll() { //resets the read and write positions in the buffer (only in the selected slot)
+      memset(slotPosition, 0, slotWords * 4); //all data of the slot, lines are 0 and refer to burst 0, which is blank
       readPosition[0] = 0;
       readPosition[1] = 0;
       writePosition = 1;
+      poolWrite = 1;
+      poolLast = 0;
+      extentMin = INT32_MAX; //no lines, no extents
+      extentMax = INT32_MIN;
+    }
+    void SetSlots(uint8_t tempCount) { //splits the buffer in a number of equal slots and clears all of them, selecting slot 0
+      tempCount = constrain(tempCount, 1, BUFFER_SLOTS);
+      slotCount = tempCount;
+      for (uint8_t s = 0; s < BUFFER_SLOTS; s++) { //all slots are empty, in the current mode
+        slotWritePosition[s] = 1;
+        slotMode[s] = bufferMode;
+        slotPoolWrite[s] = 1;
+        slotPoolLast[s] = 0;
+        slotExtentMin[s] = INT32_MAX;
+        slotExtentMax[s] = INT32_MIN;
+      }
+      memset(bufferMemory, 0, sizeof(bufferMemory)); //also the words left over after the last slot
+      slotActive = 0;
+      SlotPointers();
+      ClearAll();
+    }
+    int8_t SelectSlot(uint8_t tempSlot) { //makes a slot the active one, with its own lines and mode, and starts reading at its start. Returns -1 if the slot does not exist
+      if (tempSlot >= slotCount) return -1;
+      slotWritePosition[slotActive] = writePosition; //keep the state of the current slot
+      slotMode[slotActive] = bufferMode;
+      slotPoolWrite[slotActive] = poolWrite;
+      slotPoolLast[slotActive] = poolLast;
+      slotExtentMin[slotActive] = extentMin;
+      slotExtentMax[slotActive] = extentMax;
+      slotActive = tempSlot;
+      SlotPointers();
+      writePosition = slotWritePosition[tempSlot];
+      bufferMode = slotMode[tempSlot];
+      poolWrite = slotPoolWrite[tempSlot];
+      poolLast = slotPoolLast[tempSlot];
+      extentMin = slotExtentMin[tempSlot];
+      extentMax = slotExtentMax[tempSlot];
+      Reset();
+      return tempSlot;
+    }
+    void SetCompression(uint8_t tempMode) { //turns compression on or off, this clears all slots
+      if (tempMode == BUFFER_COMPRESSION_OFF || tempMode == BUFFER_COMPRESSION_REPEAT) {
+        bufferCompression = tempMode;
+        SetSlots(slotCount);
+      }
+    }
+    uint8_t GetCompression() {
+      return bufferCompression;
+    }
+    int32_t GetPoolSize() { //returns the number of bursts each slot can hold with compression on
+      return poolSize;
+    }
+    int32_t PoolLeft() { //returns the number of new bursts that fit in the pool of the selected slot
+      if (slotBurstNumber == 0) return 0;
+      int32_t tempOldest = 0; //the oldest burst still in use
+      if (bufferMode == BUFFER_MODE_CLEARING) { //the burst of the line furthest behind is the oldest, everything before it is free
+        if (ReadLeftSide(0) > ReadLeftSide(1)) tempOldest = slotBurstNumber[readPosition[0]];
+        else tempOldest = slotBurstNumber[readPosition[1]];
+      }
+      int32_t tempCalc = poolSize;
+      tempCalc += tempOldest;
+      tempCalc -= poolWrite;
+      tempCalc = tempCalc % poolSize; //constrain to pool size
+      tempCalc -= 1; //subtract one because write can never be equal to the oldest
+      return tempCalc;
+    }
+    uint8_t GetSlot() {
+      return slotActive;
+    }
+    uint8_t GetSlotCount() {
+      return slotCount;
+    }
+    int32_t GetSlotSize() {
+      return slotSize;
+    }
+    int32_t GetSlotLines(uint8_t tempSlot) { //returns how many lines were written to a slot since it was cleared (static and looping mode)
+      if (tempSlot >= slotCount) return -1;
+      if (tempSlot == slotActive) return writePosition - 1;
+      return slotWritePosition[tempSlot] - 1;
     }
     void Reset() { //only resets the read position to the first array position
       readPosition[0] = 0;
       readPosition[1] = 0;
+      repeatIndex[0] = 0;
+      repeatIndex[1] = 0;
+    }
+    void SetRepeat(int32_t tempPitch, uint32_t tempCount) { //sets the step and repeat pitch (0 is off) and count (0 is endless), used in looping mode
+      repeatPitch = tempPitch;
+      repeatCount = tempCount;
+    }
+    int32_t GetRepeatPitch() {
+      return repeatPitch;
+    }
+    uint32_t GetRepeatCount() {
+      return repeatCount;
+    }
+    uint32_t GetRepeatIndex(uint8_t tempSide) { //returns which repeat of the pattern a side is on
+      return repeatIndex[tempSide & 1];
+    }
+    int32_t Seek(uint8_t tempSide, int32_t tempPosition) { //places the read position of a side so the next line read is the line covering the position, returns that line
+      //only in static and looping mode, where the lines from the first one on are all kept. The positions need to go one way
+      tempSide &= 1; //constrain side
+      if (bufferMode == BUFFER_MODE_CLEARING) return -1;
+      int32_t tempLast = writePosition - 1; //the lines are 1 to write position - 1, line 0 is the empty start
+      if (tempLast < 1) return -1;
+      repeatIndex[tempSide] = 0;
+      if (RepeatActive() == 1) { //find the repeat the position is in, then search the pattern with the position moved back
+        int32_t tempRepeat = (tempPosition - slotPosition[1]) / repeatPitch;
+        if (tempRepeat < 0) tempRepeat = 0;
+        if (repeatCount != 0 && uint32_t(tempRepeat) >= repeatCount) tempRepeat = repeatCount - 1;
+        repeatIndex[tempSide] = tempRepeat;
+        tempPosition -= tempRepeat * repeatPitch;
+      }
+      int8_t tempDirection = 1;
+      if (slotPosition[tempLast] < slotPosition[1]) { //positions go down, search on the negative positions
+        tempDirection = -1;
+        tempPosition = -tempPosition;
+      }
+      int32_t tempFound = 0; //the last line that was passed at the position, 0 if none
+      int32_t tempLow = 1, tempHigh = tempLast;
+      while (tempLow <= tempHigh) { //binary search
+        int32_t tempMiddle = (tempLow + tempHigh) / 2;
+        if (slotPosition[tempMiddle] * tempDirection <= tempPosition) {
+          tempFound = tempMiddle;
+          tempLow = tempMiddle + 1;
+        }
+        else {
+          tempHigh = tempMiddle - 1;
+        }
+      }
+      readPosition[tempSide] = tempFound > 0 ? tempFound - 1 : 0; //the next read goes to the found line
+      return tempFound;
     }
     uint16_t GetPulse(uint8_t temp_address) {
       temp_address = constrain(temp_address, 0, 21);
       uint16_t tempPulse = 0; //make the return pulse
-      tempPulse = tempPulse & PRIMITIVE_OVERLAY_EVEN & burstBuffer[readPosition[0]][temp_address];
-      tempPulse = tempPulse & PRIMITIVE_OVERLAY_ODD & burstBuffer[readPosition[1]][temp_address];
+      tempPulse = tempPulse & PRIMITIVE_OVERLAY_EVEN & LineBurst(readPosition[0])[temp_address];
+      tempPulse = tempPulse & PRIMITIVE_OVERLAY_ODD & LineBurst(readPosition[1])[temp_address];
       return tempPulse;
     }
     void SetActive(uint8_t tempSide, uint8_t tempState) { //set which side (odd or even) is on or off
@@ -188,18 +395,23 @@ class Buffer {
       }
       
     }
+    uint8_t GetPrintMode(){ //returns what mode the head prints at. 0 is both on, 1 is odd only, 2 is even only
+      return bufferPrintMode;
+    }
     uint16_t *GetBurst(uint16_t tempBurst[22]) { //gets the complete current burst, based on the 2 positions from buffer and writes it to the input uint16_t[22] array
       uint16_t tempOdd, tempEven; //temporary burst values
+      uint16_t *tempOddBurst = LineBurst(readPosition[0]); //decode the lines of both sides once
+      uint16_t *tempEvenBurst = LineBurst(readPosition[1]);
       for (uint8_t a = 0; a < 22; a++) { //walk through the entire pulse
         tempBurst[a] = 0; //reset value
         if (sideActive[0] == 1 && bufferPrintMode != BUFFER_PRINT_MODE_EVEN) { //if odd side is active
-          tempOdd = PRIMITIVE_OVERLAY_ODD & burstBuffer[readPosition[0]][a]; //odd side
+          tempOdd = PRIMITIVE_OVERLAY_ODD & tempOddBurst[a]; //odd side
         }
         else {
           tempOdd = 0;
         }
         if (sideActive[1] == 1 && bufferPrintMode != BUFFER_PRINT_MODE_ODD) { //if even side is active
-          tempEven = PRIMITIVE_OVERLAY_EVEN & burstBuffer[readPosition[1]][a]; //even side
+          tempEven = PRIMITIVE_OVERLAY_EVEN & tempEvenBurst[a]; //even side
         }
         else {
           tempEven = 0;
@@ -211,11 +423,64 @@ class Buffer {
     }
     int32_t GetPosition(uint8_t tempSide) {
       tempSide &= 1; //constrain side
-      return positionBuffer[readPosition[tempSide]];
+      return slotPosition[readPosition[tempSide]] + int32_t(repeatIndex[tempSide]) * repeatPitch;
     }
     uint8_t GetLoopCounter(){
       return bufferLoopCounter;
     }
+    uint8_t OutsideJob(int32_t tempPosition, int32_t tempMargin) { //returns 1 if a position is more than the margin away from every line of the selected slot, including its repeats
+      if (extentMin > extentMax) return 1; //no lines
+      int64_t tempMin = int64_t(extentMin) - tempMargin;
+      int64_t tempMax = int64_t(extentMax) + tempMargin;
+      if (RepeatActive()) {
+        int64_t tempShift = int64_t(repeatPitch) * int64_t(repeatCount - 1);
+        if (repeatCount == 0) tempShift = (repeatPitch > 0) ? INT64_MAX / 2 : INT64_MIN / 2; //endless pattern, it covers everything ahead
+        if (tempShift > 0) tempMax += tempShift;
+        else tempMin += tempShift;
+      }
+      if (tempPosition < tempMin || tempPosition > tempMax) return 1;
+      return 0;
+    }
 
   private:
+    uint8_t RepeatActive() { //returns 1 if the pattern is stepped and repeated
+      if (bufferMode == BUFFER_MODE_LOOPING && repeatPitch != 0 && writePosition > 1) return 1;
+      return 0;
+    }
+    void AddExtent(int32_t tempPosition) { //widens the extents of the selected slot to a new line
+      if (tempPosition < extentMin) extentMin = tempPosition;
+      if (tempPosition > extentMax) extentMax = tempPosition;
+    }
+    uint16_t *LineBurst(int32_t tempLine) { //returns the burst of a line in the selected slot
+      if (slotBurstNumber != 0) return slotBurst[slotBurstNumber[tempLine]];
+      return slotBurst[tempLine];
+    }
+    void PoolAdd(uint16_t tempInput[22]) { //gives the line at the write position its burst, a new one in the pool unless it repeats the last line
+      if (memcmp(slotBurst[poolLast], tempInput, 44) != 0) {
+        poolLast = poolWrite;
+        memcpy(slotBurst[poolLast], tempInput, 44);
+        poolWrite++;
+        if (poolWrite >= poolSize) poolWrite = 0; //overflow protection
+      }
+      slotBurstNumber[writePosition] = poolLast;
+    }
+    void SlotPointers() { //points the slot data at the memory of the selected slot, in the layout of the compression mode
+      slotWords = (BUFFER_SIZE * 12) / slotCount;
+      uint32_t *tempMemory = bufferMemory + slotActive * slotWords;
+      int32_t tempLines = slotWords / 12;
+      slotPosition = (int32_t *)tempMemory;
+      if (bufferCompression == BUFFER_COMPRESSION_REPEAT) { //positions (1 word) and burst numbers (half a word) per line, then the pool
+        slotSize = tempLines * BUFFER_COMPRESSION_LINES;
+        slotBurstNumber = (uint16_t *)(tempMemory + slotSize);
+        tempMemory += slotSize + (slotSize + 1) / 2;
+        poolSize = (slotWords - slotSize - (slotSize + 1) / 2) / 11;
+      }
+      else { //positions (1 word) per line, then the bursts (11 words) per line
+        slotSize = tempLines;
+        slotBurstNumber = 0;
+        tempMemory += slotSize;
+        poolSize = 0;
+      }
+      slotBurst = (uint16_t (*)[22])tempMemory;
+    }
 };
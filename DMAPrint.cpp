@@ -47,11 +47,10 @@
 
 #include <string.h>
 #include "DMAPrint.h"
+#include "Profiler.h"
+#include "HeadSense.h"
 
 #define CHECK_THRESHOLD 10 //how many short pulses each nozzle receives to test it
-#define TEMPERATURE_SENSE_R1 330.0 //the resistance of the temperature sense divider
-#define VOLTAGE_SENSE_R1 10000.0 //the resistance of the first resistor in all voltage sensing
-#define VOLTAGE_SENSE_R2 1200.0 //the resistance of the second resistor in all voltage sensing
 //#define PRINT_DEBUG //uncomment this line to get more in depth reports of all functions over serial
 
 uint16_t DMAPrint::dmaBufferSize;
@@ -67,6 +66,83 @@ DMAChannel DMAPrint::dma3;
 static volatile uint8_t updateInProgress = 0;
 static uint32_t update_completed_at = 0;
 
+//background ADC variables
+//the sense lines are sampled in the background, using the conversion complete interrupt to chain the conversions.
+//ADC0 reads TSR and then 10X, ADC1 reads logic and then head voltage, both at the same time. A sequence is only started
+//when no burst is running and is stopped by the next burst, so no conversion sees the printhead firing
+#define ADC_TSR 0
+#define ADC_10X 1
+#define ADC_LOGIC 2
+#define ADC_HEAD 3
+#define ADC_VALUES 4
+#define ADC_CHANNEL_TSR 8 //A2 on ADC0
+#define ADC_CHANNEL_10X 9 //A3 on ADC0
+#define ADC_CHANNEL_LOGIC 14 //A12 on ADC1
+#define ADC_CHANNEL_HEAD 15 //A13 on ADC1
+#define ADC_CHANNEL_OFF 31 //stops the ADC
+#define ADC_SAMPLE_INTERVAL 20 //time in milliseconds between each background sequence
+#define ADC_MAX_ABORTS 50 //after this many sequences in a row were stopped by a burst, a sequence is allowed to run during a burst
+#define ADC_FILTER_SHIFT 3 //the filter takes 1/8th of each new sample, filtered values hold 3 extra bits
+#if F_BUS > 48000000 //the ADC clock in 16 bit mode can be at most 12MHz, same as the core library picks
+#define ADC_CLOCK (ADC_CFG1_ADIV(2) | ADC_CFG1_ADICLK(1)) //bus / 8, 7.5MHz at a 60MHz bus
+#else
+#define ADC_CLOCK (ADC_CFG1_ADIV(1) | ADC_CFG1_ADICLK(1)) //bus / 4, 12MHz at a 48MHz bus
+#endif
+static volatile uint16_t adcRaw[ADC_VALUES]; //the samples of the running sequence (13 bit)
+static volatile uint32_t adcFiltered[ADC_VALUES]; //the filtered values (13 bit, shifted up by the filter shift)
+static volatile uint8_t adcStep[2]; //where in the sequence each ADC is
+static volatile uint8_t adcRunning = 0; //how many ADC's are still converting in the running sequence
+static volatile uint8_t adcSuspended = 0; //set while a blocking analogRead is done, the background then waits
+static volatile uint32_t adcSamples = 0; //how many complete sequences were filtered
+static uint32_t adcLastStart = 0; //when the last sequence was started in milliseconds
+static uint16_t adcAborts = 0; //how many sequences in a row were stopped by a burst
+static uint8_t adcForced = 0; //whether the running sequence is allowed to run during a burst
+
+//pulse width variables
+//the length of a pulse is set by the period of the DMA timer, each pulse lasts 2 timer periods in long mode.
+//The pulse width is picked from a table by head temperature and head voltage, so the energy in each pulse stays the same.
+//A new period is only written while the timer is stopped at the start of a burst
+#define PULSE_TEMPERATURE_STEPS 5
+#define PULSE_VOLTAGE_STEPS 4
+#define PULSE_WIDTH_MIN 1000 //the shortest allowed pulse width in nanoseconds
+#define PULSE_WIDTH_MAX 3000 //the longest allowed pulse width in nanoseconds
+#define PULSE_SLOTS 2 //how many timer periods a long pulse lasts
+static const int16_t pulseTemperatureStep[PULSE_TEMPERATURE_STEPS] = {0, 200, 350, 450, 550}; //the lowest temperature (in .1C) of each row of the table
+static const uint16_t pulseVoltageStep[PULSE_VOLTAGE_STEPS] = {0, 9000, 11000, 13000}; //the lowest head voltage (in mV) of each column of the table
+static uint16_t pulseWidthTable[PULSE_TEMPERATURE_STEPS][PULSE_VOLTAGE_STEPS] = { //pulse width in nanoseconds
+  {3000, 2880, 2000, 1470}, //below 20C
+  {3000, 2743, 1905, 1400}, //20C to 35C, 11V to 13V is the default 1.05MHz timing
+  {3000, 2606, 1810, 1330}, //35C to 45C
+  {3000, 2469, 1715, 1260}, //45C to 55C
+  {2915, 2332, 1619, 1190}  //above 55C
+};
+static uint8_t pulseWidthCompensation = 1; //whether the pulse width follows the table (1) or stays at the default timing (0)
+static uint16_t pulseWidth = 0; //the pulse width currently in use in nanoseconds
+static uint8_t pulseWidthIndex = 0; //the table position currently in use (temperature step * voltage steps + voltage step)
+static volatile uint32_t pulseTimerMod = 0; //the timer period belonging to the pulse width
+static volatile uint8_t pulseTimerChanged = 0; //set when the timer period should be rewritten at the next burst
+
+//pulse train variables
+//preheat and prime pulse trains repeat the same frame many times. The frame stays in the DMA memory, and PulseTrainUpdate()
+//starts the next frame from the main loop once the last one is done, so the main loop keeps running while the train fires.
+//Each frame is started the same way as a burst, with the same gap and the same clearing of old DMA requests
+#define PULSE_TRAIN_STOP_TIMEOUT 2000 //time in microseconds a stop waits for the frame in progress before the DMA is stopped
+static volatile uint8_t pulseTrainRunning = 0; //whether a pulse train is firing
+static volatile uint16_t pulseTrainLeft = 0; //how many frames of the train still need to be fired after the current one
+static uint32_t pulseTrainFrames = 0; //frames fired by all pulse trains since startup, never reset
+
+//nozzle compensation variables
+//drops for nozzles that were found dead by TestHead are moved to the nearest working nozzle in the same row (2 nozzles up or down).
+//The other row prints a different line (row gap) in the same burst, so it can not take over drops.
+#define NOZZLE_REMAP_MAX 64 //the most dead nozzles that can be moved
+static uint8_t nozzleCompensation = 0; //whether dead nozzles are compensated
+static uint16_t nozzleDeadMask[22]; //the dead nozzles for each address
+static uint8_t nozzleRemapCount = 0; //how many dead nozzles are moved
+static uint8_t nozzleRemapAddress[NOZZLE_REMAP_MAX]; //the address of each dead nozzle
+static uint16_t nozzleRemapBit[NOZZLE_REMAP_MAX]; //the primitive bit of each dead nozzle
+static uint8_t nozzleRemapTargetAddress[NOZZLE_REMAP_MAX]; //the address of the nozzle that takes over
+static uint16_t nozzleRemapTargetBit[NOZZLE_REMAP_MAX]; //the primitive bit of the nozzle that takes over
+
 //pin variables
 //pins in use for port C: 9,10,11,12,13,15,22,23
 //pins in use for port D: 2,5,6,7,8,14,20,21
@@ -89,7 +165,7 @@ static uint8_t testVoltageHead = A13; //reference for the head voltage line
 static uint8_t testAddress = A17; //test for the address functionality
 
 static uint16_t dpi = 600; //resolution of printhead
-static uint16_t dpiRepeat = 1; //how often each to be printed pixel is repeated (calculated from DPI)
+static uint16_t dpiNozzle[301]; //first nozzle of each input pixel, the pixel ends where the next one starts, 300 when past the last nozzle (calculated from DPI)
 
 //variables
 static uint8_t headEnabled; //whether the printhead is enabled or not
@@ -154,6 +230,7 @@ DMAPrint::DMAPrint(uint32_t tempBufferSize, void *portCMem , void *portDMem, voi
   portCWrite = portCWri;
   portDWrite = portDWri;
   dmaFrequency = tempFrequency;
+  SetDPI(dpi); //build the default pixel to nozzle table
 }
 
 #define WS2811_TIMING_T0H  10 //used to offset trigger D (It wont take same triggers) not all frequencies support all offsets
@@ -168,6 +245,12 @@ void DMAPrint::begin(uint32_t tempBufferSize, void *portCMem , void *portDMem, v
   portDWrite = portDWri;
   dmaFrequency = tempFrequency;
   begin();
+}
+
+//DMA functions ----------------------------------------------------------
+void DMAPrint::begin(void) {
+  //Serial.println("Starting DMA printhead");
+  uint32_t bufsize, frequency;
 
   //generate reverse nozzle table ----------------------------------------------------
   for (uint8_t a = 0; a < 22; a++) { //fill -1 in all positions
@@ -180,12 +263,6 @@ void DMAPrint::begin(uint32_t tempBufferSize, void *portCMem , void *portDMem, v
     nozzleTableReverse[nozzleTablePrimitive[n]][nozzleTableAddress[n]] = n;
     //Serial.print(n); Serial.print(", "); Serial.print(nozzleTablePrimitive[n]); Serial.print(", "); Serial.print(nozzleTableAddress[n]); Serial.println("");
   }
-}
-
-//DMA functions ----------------------------------------------------------
-void DMAPrint::begin(void) {
-  //Serial.println("Starting DMA printhead");
-  uint32_t bufsize, frequency;
   bufsize = dmaBufferSize;
 
   // set up the buffers
@@ -221,6 +298,14 @@ void DMAPrint::begin(void) {
   pinMode(testVoltageHead, INPUT);
   pinMode(testAddress, INPUT);
 
+  //background ADC
+  attachInterruptVector(IRQ_ADC0, adcIsr0);
+  attachInterruptVector(IRQ_ADC1, adcIsr1);
+  NVIC_SET_PRIORITY(IRQ_ADC0, 192); //lower than the DMA
+  NVIC_SET_PRIORITY(IRQ_ADC1, 192);
+  NVIC_ENABLE_IRQ(IRQ_ADC0);
+  NVIC_ENABLE_IRQ(IRQ_ADC1);
+
   // configure the 8 port C output pins
   GPIOC_PCOR = 0xFF;
   pinMode(15, OUTPUT); //C0
@@ -373,6 +458,16 @@ int DMAPrint::busy(void) {
 
 //complex printing functions ----------------------------------------------------------
 void DMAPrint::Burst(void) { //<--------------------- change this name to something more representative of DMAPrint
+  PROFILER_START(PROFILER_BURST);
+  if (pulseTrainRunning == 1) PulseTrainStop(); //a burst always goes before a running pulse train
+  DMAStart(1);
+  PROFILER_STOP(PROFILER_BURST);
+}
+void DMAPrint::DMAStart(uint8_t tempCopy) { //fires the frame in the DMA memory, copying the write buffers to it first if copy is 1
+  if (adcRunning != 0 && adcForced == 0) { //stop any background conversion, the firing printhead would disturb it
+    AdcStop();
+    adcAborts++;
+  }
   AddressReset(); //reset the address before printing
 
   // wait for any prior DMA operation
@@ -381,10 +476,10 @@ void DMAPrint::Burst(void) { //<--------------------- change this name to someth
   //Serial1.print("2");
   // it's ok to copy the drawing buffer to the frame buffer
   // during the 50us WS2811 reset time
-  if (portDWrite != portDMemory) {
+  if (tempCopy == 1 && portDWrite != portDMemory) {
     memcpy(portDMemory, portDWrite, dmaBufferSize);
   }
-  if (portCWrite != portCMemory) {
+  if (tempCopy == 1 && portCWrite != portCMemory) {
     memcpy(portCMemory, portCWrite, dmaBufferSize);
   }
   // wait for WS2811 reset
@@ -430,6 +525,12 @@ void DMAPrint::Burst(void) { //<--------------------- change this name to someth
   while (FTM2_CNT < cv) ;
   FTM2_SC = 0;             // stop FTM2 timer (hopefully before it rolls over)
   FTM2_CNT = 0;
+  if (pulseTimerChanged == 1) { //write the new pulse width while the timer is stopped
+    FTM2_MOD = pulseTimerMod - 1;
+    FTM2_C0V = (pulseTimerMod * WS2811_TIMING_T0H) >> 8;
+    FTM2_C1V = (pulseTimerMod * WS2811_TIMING_T1H) >> 8;
+    pulseTimerChanged = 0;
+  }
   updateInProgress = 1;
   //digitalWriteFast(9, HIGH); // oscilloscope trigger
   PORTB_ISFR = (1 << 18);  // clear any prior rising edge
@@ -459,6 +560,12 @@ void DMAPrint::Burst(void) { //<--------------------- change this name to someth
   while (FTM2_CNT < cv) ;
   FTM2_SC = 0;             // stop FTM2 timer (hopefully before it rolls over)
   FTM2_CNT = 0;
+  if (pulseTimerChanged == 1) { //write the new pulse width while the timer is stopped
+    FTM2_MOD = pulseTimerMod - 1;
+    FTM2_C0V = (pulseTimerMod * WS2811_TIMING_T0H) >> 8;
+    FTM2_C1V = (pulseTimerMod * WS2811_TIMING_T1H) >> 8;
+    pulseTimerChanged = 0;
+  }
   updateInProgress = 1;
   //digitalWriteFast(9, HIGH); // oscilloscope trigger
 #if defined(__MK64FX512__)
@@ -540,6 +647,7 @@ void DMAPrint::SetBurst(uint16_t temp_input[22], uint8_t temp_mode) { //takes a
 
   //(edit: changed for testing. First data, then clock, not at the same time)
 
+  PROFILER_START(PROFILER_SET_BURST);
   //make standard values:
   uint8_t tempAllOff[] = {0, 0};
   uint8_t tempAddressNext[] = {0, 0B10000000};
@@ -585,15 +693,13 @@ void DMAPrint::SetBurst(uint16_t temp_input[22], uint8_t temp_mode) { //takes a
     set(dmaActiveSize, tempAllOff[0], tempAllOff[1]); //all off
     dmaActiveSize++;
   }
+  PROFILER_STOP(PROFILER_SET_BURST);
 }
 //takes an empty uint8_t array of 300 as an input for nozzles and returns the state of each nozzle (0 for broken, 1 for working)
 //takes an empty uint8_t array of 22 as input for addresses and returns the number of working nozzles on each address
 //takes an empty uint8_t array of 14 as input for the primitives, and returns the number of working nozzles on each primitive
 void DMAPrint::TestHead(uint8_t* tempNozzleState, uint8_t* tempAddressState, uint8_t* tempPrimitiveState) { 
-  int16_t testPulse;
-  uint8_t tempAddress, tempPrimitive;
-  int8_t tempTests;
-  uint8_t headPresent = 0; //if the printhead is attached or not
+  PulseTrainStop(); //the test needs control over the enable pin
 
   for (uint8_t a = 0; a < 22; a++){ //reset addresses
     tempAddressState[a] = 0;
@@ -602,18 +708,50 @@ void DMAPrint::TestHead(uint8_t* tempNozzleState, uint8_t* tempAddressState, uin
     tempPrimitiveState[p] = 0;
   }
 
-  for (uint16_t n = 0; n < 300; n++) {
-    tempAddress = nozzleTableAddress[n];
-    tempPrimitive = nozzleTablePrimitive[n];
+  //go through the addresses in order, so the address only needs to be stepped once for all nozzles on it
+  AddressReset();
+  for (uint8_t a = 0; a < 22; a++) {
+    AddressNext(); //step to the next address
+    TestAddressNozzles(a, tempNozzleState);
+    for (uint8_t p = 0; p < 14; p++) {
+      int16_t tempNozzle = nozzleTableReverse[p][a];
+      if (tempNozzle >= 0 && tempNozzleState[tempNozzle] == 1) {
+        tempAddressState[a] ++; //add one to address
+        tempPrimitiveState[p] ++; //add one to primitive
+      }
+    }
+  }
+}
+uint8_t DMAPrint::TestHeadAddress(uint8_t tempAddress, uint8_t* tempNozzleState) { //tests only the nozzles on one address, returns how many nozzles changed state
+  uint8_t tempChanged = 0;
+  uint8_t tempOld[14];
+  if (tempAddress >= 22) return 0;
+  PulseTrainStop(); //the test needs control over the enable pin
+  for (uint8_t p = 0; p < 14; p++) { //remember the old states
+    int16_t tempNozzle = nozzleTableReverse[p][tempAddress];
+    if (tempNozzle >= 0) tempOld[p] = tempNozzleState[tempNozzle];
+  }
 
-    //go to address
-    AddressReset();
+  //go to address
+  AddressReset();
+  for (uint8_t a = 0; a <= tempAddress; a++) { //step to the right address
     AddressNext();
-    for (uint8_t a = 0; a < tempAddress; a++) { //step to the right address
-      AddressNext();
-    }
-    testPulse = 0;
-    bitWrite(testPulse, tempPrimitive, 1); //set right primitive in pulse
+  }
+  uint8_t tempEnabled = headEnabled;
+  TestAddressNozzles(tempAddress, tempNozzleState);
+  SetEnable(tempEnabled); //set the head to previous state
+
+  for (uint8_t p = 0; p < 14; p++) {
+    int16_t tempNozzle = nozzleTableReverse[p][tempAddress];
+    if (tempNozzle >= 0 && tempOld[p] != tempNozzleState[tempNozzle]) tempChanged++;
+  }
+  return tempChanged;
+}
+void DMAPrint::TestAddressNozzles(uint8_t tempAddress, uint8_t* tempNozzleState) { //tests all nozzles on the address that is selected on the head
+  int8_t tempTests;
+  for (uint8_t p = 0; p < 14; p++) {
+    int16_t tempNozzle = nozzleTableReverse[p][tempAddress];
+    if (tempNozzle < 0) continue; //no nozzle on this primitive and address
 
     //discharge the capacitor
     SetEnable(1);
@@ -625,7 +763,7 @@ void DMAPrint::TestHead(uint8_t* tempNozzleState, uint8_t* tempAddressState, uin
     //test nozzle
     while (1) {
       //do a pulse
-      PrimitiveShortPulse(testPulse);
+      PrimitiveShortPulse(1 << p);
 
       //check if test pin is low (test circuit pulls down on positive)
       if (GetNozzleCheck() == 0) {
@@ -638,12 +776,10 @@ void DMAPrint::TestHead(uint8_t* tempNozzleState, uint8_t* tempAddressState, uin
     }
 
     if (tempTests == 0) { //if variable reached 0, nozzle never tested positive
-      tempNozzleState[n] = 0;
+      tempNozzleState[tempNozzle] = 0;
     }
     else { //if anything other than 0, nozzle is positive
-      tempNozzleState[n] = 1;
-      tempAddressState[tempAddress] ++; //add one to address
-      tempPrimitiveState[tempPrimitive] ++; //add one to primitive
+      tempNozzleState[tempNozzle] = 1;
     }
   }
 }
@@ -694,35 +830,74 @@ void DMAPrint::SingleNozzle(uint16_t tempNozzle) { //triggers a single indicated
   SetBurst(burstVar, 1); //set the burst as a long pulses
   Burst();
 }
-int8_t DMAPrint::Preheat(uint16_t tempPulses) { //does a given number of short pulses on the printhead to preheat the nozzles
-  uint16_t tempPulse = 16383;
+int8_t DMAPrint::Preheat(uint16_t tempPulses) { //starts a given number of short pulses on the printhead to preheat the nozzles, returns right away
   //Serial.print("Preheating: "); Serial.println(tempPulses);
   if (headEnabled == 0) return 0; //check if burst is possible, return a 0 if not
   //Serial.print("Head enabled, preheating");
   //tempPulses = constrain(tempPulses, 0, maxPreheatPulses);
-  for (uint8_t a = 0; a < 22; a++) {
-    burstVar[a] = tempPulse;
-  }
-  SetBurst(burstVar, 0); //set the burst as a short pulses
-  for (uint16_t pulses = 0; pulses < tempPulses; pulses++) {
-    Burst();
-  }
+  PulseTrain(tempPulses, 0); //short pulses
   return 1; //return a 1 if successful
 }
-int8_t DMAPrint::Prime(uint16_t tempPulses) { //does a given number of long pulses on the printhead to start the nozzles
-  uint16_t tempPulse = 16383;
+int8_t DMAPrint::Prime(uint16_t tempPulses) { //starts a given number of long pulses on the printhead to start the nozzles, returns right away
   //Serial.print("Preheating: "); Serial.println(tempPulses);
   if (headEnabled == 0) return 0; //check if burst is possible, return a 0 if not
   //Serial.print("Head enabled, preheating");
   //tempPulses = constrain(tempPulses, 0, maxPreheatPulses);
+  PulseTrain(tempPulses, 1); //long pulses
+  return 1; //return a 1 if successful
+}
+void DMAPrint::PulseTrain(uint16_t tempPulses, uint8_t tempMode) { //fires all nozzles a given number of times in the background (mode is long or short pulses. 1 is long, 0 is short)
+  uint16_t tempPulse = 16383;
   for (uint8_t a = 0; a < 22; a++) {
     burstVar[a] = tempPulse;
   }
-  SetBurst(burstVar, 1); //set the burst as a long pulses
-  for (uint16_t pulses = 0; pulses < tempPulses; pulses++) {
-    Burst();
+  PulseTrainBurst(burstVar, tempPulses, tempMode);
+}
+void DMAPrint::PulseTrainBurst(uint16_t temp_input[22], uint16_t tempPulses, uint8_t tempMode) { //fires a burst a given number of times in the background (mode is long or short pulses. 1 is long, 0 is short)
+  PulseTrainStop(); //stop any train still running
+  if (tempPulses == 0) return;
+  SetBurst(temp_input, tempMode);
+  Burst(); //fire the first frame
+  pulseTrainFrames++;
+  pulseTrainLeft = tempPulses - 1; //PulseTrainUpdate() fires the rest, the head stays enabled until the train is done
+  pulseTrainRunning = 1;
+}
+void DMAPrint::PulseTrainUpdate(void) { //fires the next frame of a running pulse train when the last one is done, call this every cycle
+  if (pulseTrainRunning == 0 || updateInProgress) return;
+  if (micros() - update_completed_at < 50) return; //the same gap between frames as between bursts
+  if (pulseTrainLeft > 0) {
+    pulseTrainLeft--;
+    DMAStart(0); //the frame is still in the DMA memory
+    pulseTrainFrames++;
+    return;
   }
-  return 1; //return a 1 if successful
+  pulseTrainRunning = 0;
+  EnableReset(); //set the head to the official state again
+}
+void DMAPrint::PulseTrainStop(void) { //stops a running pulse train after the frame in progress
+  if (pulseTrainRunning == 0) return;
+  pulseTrainLeft = 0;
+  uint32_t tempStart = micros();
+  while (updateInProgress) { //wait for the frame in progress
+    if (micros() - tempStart > PULSE_TRAIN_STOP_TIMEOUT) { //the frame never finished, stop the DMA
+      dma1.disable();
+      dma2.disable();
+      updateInProgress = 0;
+      update_completed_at = micros();
+      break;
+    }
+  }
+  pulseTrainRunning = 0;
+  EnableReset(); //set the head to the official state again
+}
+uint8_t DMAPrint::PulseTrainBusy(void) { //returns 1 while a pulse train is firing
+  return pulseTrainRunning;
+}
+uint32_t DMAPrint::PulseTrainGetFrames(void) { //returns how many frames all pulse trains fired since startup, so a stopped train can be counted
+  return pulseTrainFrames;
+}
+uint16_t DMAPrint::PulseTrainGetLeft(void) { //returns how many frames of the pulse train are still to be fired
+  return pulseTrainLeft;
 }
 uint8_t DMAPrint::TestAddress(void) { //tests if the address circuit fully cycles, 1 for functional, 0 for not
 #ifdef PRINT_DEBUG
@@ -833,37 +1008,47 @@ void DMAPrint::AddressReset(void) { //reset address
 //Read values ----------------------------------------------------------
 uint32_t DMAPrint::GetTSRRaw(uint8_t tempResolution) { //read TSR
   tempResolution = constrain(tempResolution, 0, 13); //limit resolution input
+  AdcSuspend(1); //the background ADC can not run while the ADC is used here
   analogReadResolution(tempResolution); //set resolution
   uint16_t temp = analogRead(senseTSR);
   analogReadResolution(10); //return resolution to 10 (default)
+  AdcSuspend(0);
   return temp;
 }
 uint32_t DMAPrint::Get10XRaw(uint8_t tempResolution) { //Read 10x
   tempResolution = constrain(tempResolution, 0, 13); //limit resolution input
+  AdcSuspend(1); //the background ADC can not run while the ADC is used here
   analogReadResolution(tempResolution); //set resolution
   uint16_t temp = analogRead(sense10X);
   analogReadResolution(10); //return resolution to 10 (default)
+  AdcSuspend(0);
   return temp;
 }
 uint32_t DMAPrint::GetVoltageLogicRaw(uint8_t tempResolution) { //read address logic voltage
   tempResolution = constrain(tempResolution, 0, 13); //limit resolution input
+  AdcSuspend(1); //the background ADC can not run while the ADC is used here
   analogReadResolution(tempResolution); //set resolution
   uint16_t res = analogRead(testVoltageLogic);
   analogReadResolution(10); //return resolution to 10 (default)
+  AdcSuspend(0);
   return res;
 }
 uint32_t DMAPrint::GetVoltageHeadRaw(uint8_t tempResolution) { //read primitive drive voltage
   tempResolution = constrain(tempResolution, 0, 13); //limit resolution input
+  AdcSuspend(1); //the background ADC can not run while the ADC is used here
   analogReadResolution(tempResolution); //set resolution
   uint16_t res = analogRead(testVoltageHead);
   analogReadResolution(10); //return resolution to 10 (default)
+  AdcSuspend(0);
   return res;
 }
 uint32_t DMAPrint::GetVoltageAddressRaw(uint8_t tempResolution) { //read primitive drive voltage
   tempResolution = constrain(tempResolution, 0, 13); //limit resolution input
+  AdcSuspend(1); //the background ADC can not run while the ADC is used here
   analogReadResolution(tempResolution); //set resolution
   uint16_t res = analogRead(testAddress);
   analogReadResolution(10); //return resolution to 10 (default)
+  AdcSuspend(0);
   return res;
 }
 uint8_t DMAPrint::GetNozzleCheck(void) { //Read nozzle check
@@ -875,81 +1060,175 @@ int32_t DMAPrint::GetTemperature(void) { //enables the head if required and calc
 
   int16_t temp10x = Get10XRaw(13); //get analog read in 13 bit resolution
   int16_t tempTsr = GetTSRRaw(13); //get analog read in 13 bit resolution
-  const float tempVin = 3.3;
-  const float tempR1 = TEMPERATURE_SENSE_R1;
-
-  //Vout = (R2 / (R2 + R1)) * Vin, R1 is 330ohm
-  //R2 = ((Vout x R1)/(Vin-Vout))
-
-  //calculate in celcius
-  float tempFCalc;
-  //get the 10x voltage
-  tempFCalc = float(temp10x);
-  tempFCalc /= 8192; //get the fraction
-  tempFCalc *= tempVin; //get the voltage
-  float temp10xRes = ((tempFCalc * tempR1) / (tempVin - tempFCalc)); //get the 10x resistance
-  //Serial.print("10X resistor: "); Serial.println(temp10xRes);
-
-  //get the tsr voltage
-  tempFCalc = float(tempTsr);
-  tempFCalc /= 8192; //get the fraction
-  tempFCalc *= tempVin; //get the voltage
-  float tempTsrRes = ((tempFCalc * tempR1) / (tempVin - tempFCalc)); //get the tsr resistance
-  //Serial.print("TSR resistor: "); Serial.println(tempTsrRes);
-
-  //check both to be reasonable values
-  if (temp10xRes < 150.0 || temp10xRes > 500.0) return -2;
-  if (tempTsrRes < 150.0 || tempTsrRes > 500.0) return -2;
-
-  //get the TSR - 10X
-  //at 10 ohms, the temperature is 20C, for every 1.1 ohms the temperature rises 1 degree
-  //T = 1.1R+10
-  tempFCalc = tempTsrRes - temp10xRes;
-  float tempTemp = 1.1 * tempFCalc + 10.0;
-  tempTemp *= 10.0; //multiply by ten to add the decimal value
-  //Serial.print("Temperature: "); Serial.println(tempTemp);
-  return long(tempTemp); //return celcius
-
   EnableReset(); //set the head to previous state
+  return CalculateTemperature(temp10x, tempTsr);
+}
+int32_t DMAPrint::CalculateTemperature(int32_t temp10x, int32_t tempTsr) { //calculates the temperature (in .1C) from 13 bit 10X and TSR readings
+  return HeadSenseTemperature(temp10x, tempTsr);
 }
 uint32_t DMAPrint::GetVoltageLogic(void) { //reads the voltage of the printhead logic and returns it in millivolts
   int16_t tempV = GetVoltageLogicRaw(13); //get analog read in 13 bit resolution
-  //Vout = (R2 / (R2 + R1)) * Vin
-  //Vin = ((R2+R1) / R2) * Vout <this one is used
-  float tempFCalc = float(tempV); //write value to the float variable
-  tempFCalc /= 8192.0; //get the fraction
-  tempFCalc *= 3.3; //create Vout value
-  float tempFCalc2 = VOLTAGE_SENSE_R1 + VOLTAGE_SENSE_R2;
-  tempFCalc2 /= VOLTAGE_SENSE_R2;
-  tempFCalc = tempFCalc2 * tempFCalc; //make output voltage
-  tempFCalc *= 1000.0;
-  return long(tempFCalc);
+  return CalculateVoltage(tempV);
 }
 uint32_t DMAPrint::GetVoltageHead(void) { //reads the voltage of the printhead driving circuitry
   int16_t tempV = GetVoltageHeadRaw(13); //get analog read in 13 bit resolution
-  //Vout = (R2 / (R2 + R1)) * Vin
-  //Vin = ((R2+R1) / R2) * Vout <this one is used
-  float tempFCalc = float(tempV); //write value to the float variable
-  tempFCalc /= 8192.0; //get the fraction
-  tempFCalc *= 3.3; //create Vout value
-  float tempFCalc2 = VOLTAGE_SENSE_R1 + VOLTAGE_SENSE_R2;
-  tempFCalc2 /= VOLTAGE_SENSE_R2;
-  tempFCalc = tempFCalc2 * tempFCalc; //make output voltage
-  tempFCalc *= 1000.0;
-  return long(tempFCalc);
+  return CalculateVoltage(tempV);
 }
 uint32_t DMAPrint::GetVoltageAddress(void) { //reads the voltage of the printhead driving circuitry
   int16_t tempV = GetVoltageAddressRaw(13); //get analog read in 13 bit resolution
-  //Vout = (R2 / (R2 + R1)) * Vin
-  //Vin = ((R2+R1) / R2) * Vout <this one is used
-  float tempFCalc = float(tempV); //write value to the float variable
-  tempFCalc /= 8192.0; //get the fraction
-  tempFCalc *= 3.3; //create Vout value
-  float tempFCalc2 = VOLTAGE_SENSE_R1 + VOLTAGE_SENSE_R2;
-  tempFCalc2 /= VOLTAGE_SENSE_R2;
-  tempFCalc = tempFCalc2 * tempFCalc; //make output voltage
-  tempFCalc *= 1000.0;
-  return long(tempFCalc);
+  return CalculateVoltage(tempV);
+}
+uint32_t DMAPrint::CalculateVoltage(int32_t tempV) { //calculates the voltage in millivolts of a sense line from a 13 bit reading
+  return HeadSenseVoltage(tempV);
+}
+
+//Background ADC ----------------------------------------------------------
+void DMAPrint::AdcUpdate(void) { //starts a new background sequence when it is time, call this every cycle
+  if (adcRunning != 0 || adcSuspended == 1) return; //busy
+  if (updateInProgress) return; //never start during a burst
+  if (pulseTrainRunning == 1) return; //the frames of a pulse train follow each other closely, a sequence would only be stopped or forced during one
+  if (millis() - adcLastStart < ADC_SAMPLE_INTERVAL) return;
+  if ((ADC0_SC3 & ADC_SC3_CAL) || (ADC1_SC3 & ADC_SC3_CAL)) return; //analogReadResolution() started a calibration, writing the registers now would abort it
+  adcLastStart = millis();
+  adcForced = 0;
+  if (adcAborts >= ADC_MAX_ABORTS) { //bursts never leave room, sample anyway so there is still monitoring
+    adcForced = 1;
+  }
+
+  SetEnableTemp(1); //the TSR and 10X only work with the head enabled
+  AddressReset(); //reset address because else for magical reasons the 10X will fail to read
+
+  //set both ADC's to 16 bit (read as 13 bit), and average 8 samples per conversion
+  ADC0_CFG1 = ADC_CLOCK | ADC_CFG1_MODE(3) | ADC_CFG1_ADLSMP;
+  ADC1_CFG1 = ADC_CLOCK | ADC_CFG1_MODE(3) | ADC_CFG1_ADLSMP;
+  ADC0_CFG2 = ADC_CFG2_ADLSTS(2);
+  ADC1_CFG2 = ADC_CFG2_ADLSTS(2);
+  ADC0_SC2 = 0; //software trigger
+  ADC1_SC2 = 0;
+  ADC0_SC3 = ADC_SC3_AVGE | ADC_SC3_AVGS(1);
+  ADC1_SC3 = ADC_SC3_AVGE | ADC_SC3_AVGS(1);
+
+  adcStep[0] = 0;
+  adcStep[1] = 0;
+  adcRunning = 2;
+  ADC0_SC1A = ADC_SC1_AIEN | ADC_SC1_ADCH(ADC_CHANNEL_TSR); //start the first conversions
+  ADC1_SC1A = ADC_SC1_AIEN | ADC_SC1_ADCH(ADC_CHANNEL_LOGIC);
+}
+void DMAPrint::AdcStop(void) { //stops the running sequence, the samples of it are not used
+  ADC0_SC1A = ADC_SC1_ADCH(ADC_CHANNEL_OFF);
+  ADC1_SC1A = ADC_SC1_ADCH(ADC_CHANNEL_OFF);
+  if (adcRunning != 0) {
+    adcRunning = 0;
+    EnableReset(); //set the head to previous state
+  }
+}
+void DMAPrint::AdcSuspend(uint8_t tempState) { //suspends the background while the ADC is used directly
+  if (tempState == 1) {
+    adcSuspended = 1;
+    AdcStop();
+  }
+  else {
+    adcSuspended = 0;
+  }
+}
+void DMAPrint::AdcFinish(void) { //called when both ADC's finished their sequence, filters the new samples
+  for (uint8_t v = 0; v < ADC_VALUES; v++) {
+    uint32_t tempSample = uint32_t(adcRaw[v]) << ADC_FILTER_SHIFT;
+    if (adcSamples == 0) { //start the filter on the first sample
+      adcFiltered[v] = tempSample;
+    }
+    else { //filtered += (new - filtered) / 8
+      adcFiltered[v] = adcFiltered[v] - (adcFiltered[v] >> ADC_FILTER_SHIFT) + (tempSample >> ADC_FILTER_SHIFT);
+    }
+  }
+  adcSamples++;
+  adcAborts = 0;
+  EnableReset(); //set the head to previous state, unless a pulse train still needs it
+}
+void DMAPrint::adcIsr0(void) { //ADC0 conversion complete, TSR and then 10X
+  uint16_t tempRaw = ADC0_RA >> 3; //16 bit to 13 bit (reading also clears the interrupt)
+  if (adcRunning == 0) return; //stopped
+  if (adcStep[0] == 0) {
+    adcRaw[ADC_TSR] = tempRaw;
+    adcStep[0] = 1;
+    ADC0_SC1A = ADC_SC1_AIEN | ADC_SC1_ADCH(ADC_CHANNEL_10X); //next conversion
+  }
+  else {
+    adcRaw[ADC_10X] = tempRaw;
+    adcRunning--;
+    if (adcRunning == 0) AdcFinish();
+  }
+}
+void DMAPrint::adcIsr1(void) { //ADC1 conversion complete, logic and then head voltage
+  uint16_t tempRaw = ADC1_RA >> 3; //16 bit to 13 bit (reading also clears the interrupt)
+  if (adcRunning == 0) return; //stopped
+  if (adcStep[1] == 0) {
+    adcRaw[ADC_LOGIC] = tempRaw;
+    adcStep[1] = 1;
+    ADC1_SC1A = ADC_SC1_AIEN | ADC_SC1_ADCH(ADC_CHANNEL_HEAD); //next conversion
+  }
+  else {
+    adcRaw[ADC_HEAD] = tempRaw;
+    adcRunning--;
+    if (adcRunning == 0) AdcFinish();
+  }
+}
+uint32_t DMAPrint::AdcGetSamples(void) { //returns how many background sequences were completed, 0 means no values yet
+  return adcSamples;
+}
+int32_t DMAPrint::GetTemperatureFiltered(void) { //returns the background temperature (in .1C) without blocking
+  return CalculateTemperature(adcFiltered[ADC_10X] >> ADC_FILTER_SHIFT, adcFiltered[ADC_TSR] >> ADC_FILTER_SHIFT);
+}
+uint32_t DMAPrint::GetVoltageLogicFiltered(void) { //returns the background logic voltage in millivolts without blocking
+  return CalculateVoltage(adcFiltered[ADC_LOGIC] >> ADC_FILTER_SHIFT);
+}
+uint32_t DMAPrint::GetVoltageHeadFiltered(void) { //returns the background head voltage in millivolts without blocking
+  return CalculateVoltage(adcFiltered[ADC_HEAD] >> ADC_FILTER_SHIFT);
+}
+
+//pulse width functions ----------------------------------------------------------
+void DMAPrint::PulseWidthUpdate(void) { //picks the pulse width belonging to the current head temperature and voltage
+  uint16_t tempWidth = (PULSE_SLOTS * 1000000000UL + dmaFrequency / 2) / dmaFrequency; //the default pulse width
+  uint8_t tempIndex = 255; //no table position in use
+  int32_t tempTemperature = GetTemperatureFiltered();
+  if (pulseWidthCompensation == 1 && adcSamples > 0 && tempTemperature != -2) { //only compensate on valid readings
+    uint32_t tempVoltage = GetVoltageHeadFiltered();
+    uint8_t t = 0, v = 0;
+    while (t < PULSE_TEMPERATURE_STEPS - 1 && tempTemperature >= pulseTemperatureStep[t + 1]) t++;
+    while (v < PULSE_VOLTAGE_STEPS - 1 && tempVoltage >= pulseVoltageStep[v + 1]) v++;
+    tempWidth = pulseWidthTable[t][v];
+    tempIndex = t * PULSE_VOLTAGE_STEPS + v;
+  }
+  pulseWidthIndex = tempIndex;
+  if (tempWidth == pulseWidth) return; //nothing changed
+  pulseWidth = tempWidth;
+
+  //period = width / slots, mod = F_BUS * period
+  uint32_t tempMod = ((F_BUS / 1000) * tempWidth + (PULSE_SLOTS * 1000000UL) / 2) / (PULSE_SLOTS * 1000000UL);
+  noInterrupts();
+  pulseTimerMod = tempMod;
+  pulseTimerChanged = 1;
+  interrupts();
+}
+void DMAPrint::SetPulseWidthCompensation(uint8_t tempState) { //sets whether the pulse width follows the temperature and voltage (1) or not (0)
+  if (tempState == 1) pulseWidthCompensation = 1;
+  else pulseWidthCompensation = 0;
+  PulseWidthUpdate();
+}
+uint8_t DMAPrint::GetPulseWidthCompensation(void) { //returns whether the pulse width is compensated
+  return pulseWidthCompensation;
+}
+void DMAPrint::SetPulseWidthTable(uint8_t tempIndex, uint16_t tempWidth) { //sets one position (temperature step * voltage steps + voltage step) of the pulse width table in nanoseconds
+  if (tempIndex >= PULSE_TEMPERATURE_STEPS * PULSE_VOLTAGE_STEPS) return;
+  tempWidth = constrain(tempWidth, PULSE_WIDTH_MIN, PULSE_WIDTH_MAX);
+  pulseWidthTable[tempIndex / PULSE_VOLTAGE_STEPS][tempIndex % PULSE_VOLTAGE_STEPS] = tempWidth;
+  PulseWidthUpdate();
+}
+uint16_t DMAPrint::GetPulseWidth(void) { //returns the pulse width currently in use in nanoseconds
+  return pulseWidth;
+}
+uint8_t DMAPrint::GetPulseWidthIndex(void) { //returns the table position currently in use, 255 for the default timing
+  return pulseWidthIndex;
 }
 
 //Raw pin modifications ----------------------------------------------------------
@@ -962,11 +1241,11 @@ void DMAPrint::SetPrimitiveClock(uint8_t tempState) { //set primitive clock
   }
 }
 void DMAPrint::SetPrimitivePins(uint16_t tempState) { //set primitive pins
-  uint8_t tempValue;
-  for (uint8_t p = 0; p < 14; p++) { //loop through
-    tempValue = bitRead(tempState, p); //get correct bit from value
-    digitalWrite(primtivePins[p], tempValue); //
-  }
+  //the primitives are C0-C7 and D0-D5, so they are written with a set and clear on both ports instead of a digitalWrite per pin
+  GPIOC_PSOR = tempState & 0xFF;
+  GPIOC_PCOR = ~tempState & 0xFF;
+  GPIOD_PSOR = (tempState >> 8) & 0x3F;
+  GPIOD_PCOR = ~(tempState >> 8) & 0x3F;
 }
 void DMAPrint::SetAddressClock(uint8_t tempState) { //set address next
   if (tempState == 1) {
@@ -985,12 +1264,13 @@ void DMAPrint::SetAddressReset(uint8_t tempState) { //set address reset
   }
 }
 void DMAPrint::SetEnable(uint8_t tempState) { //sets the enable state of the printhead to 0 or 1
+  //while a pulse train runs, the pin stays enabled and is set to this state when the train is done
   if (tempState == 1) {
-    digitalWrite(headEnable, 1);
+    if (pulseTrainRunning == 0) digitalWrite(headEnable, 1);
     headEnabled = 1; //set enabled state to 1
   }
   else {
-    digitalWrite(headEnable, 0);
+    if (pulseTrainRunning == 0) digitalWrite(headEnable, 0);
     headEnabled = 0; //set enabled state to 0
   }
 }
@@ -1003,6 +1283,7 @@ void DMAPrint::SetEnableTemp(uint8_t tempState) { //sets the enable state of the
   }
 }
 void DMAPrint::EnableReset() { //set enable to last official state
+  if (pulseTrainRunning == 1) return; //the pulse train sets the state when it is done
   digitalWrite(headEnable, headEnabled);
 }
 
@@ -1032,42 +1313,43 @@ uint16_t *DMAPrint::ConvertB6RawToBurst(uint8_t temp_input[50], uint16_t temp_bu
   for (uint8_t a = 0; a < 22; a++) {
     temp_burst[a] = 0;
   }
+  uint16_t tempPixel = 0; //keeps track of the current input pixel
   for (uint8_t B = 0; B < 50; B++) { //bytes within byte
     for (uint8_t b = 0; b < 6; b++) { //bits within byte
-      for (uint8_t r = 0; r < dpiRepeat; r++) { //repeat pixels
-        if (tempNozzle < 300) { //only look if nozzle is lower than 300 (some resolutions give halve filled B64 values)
-          temp_add = nozzleTableAddress[tempNozzle];
-          temp_prim = nozzleTablePrimitive[tempNozzle];
-          //if (b%2 == 1){ //TEMPORARY, ONLY PRINT ODD OR EVEN
-          temp_state = bitRead(temp_input[B], b); //get on or off from input
-          //}
-          //else {
-          //  temp_state = 0;
-          //}
-          bitWrite(temp_burst[temp_add], temp_prim, temp_state); //set nozzle in burst on or off
-          tempNozzle ++; //add one to nozzle
-        }
+      if (tempPixel >= 300) return temp_burst; //all nozzles are set (some resolutions give halve filled B64 values)
+      //if (b%2 == 1){ //TEMPORARY, ONLY PRINT ODD OR EVEN
+      temp_state = bitRead(temp_input[B], b); //get on or off from input
+      //}
+      //else {
+      //  temp_state = 0;
+      //}
+      for (tempNozzle = dpiNozzle[tempPixel]; tempNozzle < dpiNozzle[tempPixel + 1]; tempNozzle++) { //all nozzles of this pixel
+        temp_add = nozzleTableAddress[tempNozzle];
+        temp_prim = nozzleTablePrimitive[tempNozzle];
+        bitWrite(temp_burst[temp_add], temp_prim, temp_state); //set nozzle in burst on or off
       }
+      tempPixel++;
     }
   }
   return temp_burst;
 }
 uint16_t *DMAPrint::ConvertB6ToggleToBurst(uint8_t temp_input[50], uint16_t temp_burst[22]) { //takes raw data in toggle format and converts it to burst
   uint16_t tempNozzle = 0; //keeps track of the current nozzle
+  uint16_t tempPixel = 0; //keeps track of the current input pixel
   uint8_t tempState = 1; //used to write on or off to
   uint8_t tempValue;
   uint8_t temp_add, temp_prim;
   for (uint8_t B = 0; B < 50; B++) { //loop through all array values, turn on and off, stop when 300 is reached
     tempValue = temp_input[B];
     for (uint8_t R = 0; R < tempValue; R++) { //for the amount of repeats given
-      for (uint8_t r = 0; r < dpiRepeat; r++) { //repeat pixels
+      for (; tempNozzle < dpiNozzle[tempPixel + 1]; tempNozzle++) { //all nozzles of this pixel
         temp_add = nozzleTableAddress[tempNozzle];
         temp_prim = nozzleTablePrimitive[tempNozzle];
         bitWrite(temp_burst[temp_add], temp_prim, tempState); //set nozzle in burst on or off
-        tempNozzle++; //go to next nozzle
-        if (tempNozzle == 300) { //if 300 is reached, end
-          return temp_burst; //return value if 300 is reached
-        }
+      }
+      tempPixel++; //go to next pixel
+      if (tempNozzle == 300) { //if 300 is reached, end
+        return temp_burst; //return value if 300 is reached
       }
     }
     //toggle state
@@ -1079,25 +1361,92 @@ uint16_t *DMAPrint::ConvertB6ToggleToBurst(uint8_t temp_input[50], uint16_t temp
 uint16_t *DMAPrint::ConvertB8ToBurst(uint8_t temp_input[38], uint16_t temp_burst[22]) { //takes an array of 38 bytes where the 8 LSB are nozzle on or off, starting at 0 and ending at 299 and converts to a pointed uint16_t[22] burst array
   uint16_t tempNozzle = 0; //keeps track of the current nozzle
   uint8_t temp_state; //used to write on or off to
+  uint16_t tempPixel = 0; //keeps track of the current input pixel
   for (uint8_t B = 0; B < 38; B++) { //bytes within byte
     for (uint8_t b = 0; b < 8; b++) { //bits within byte
-      for (uint8_t r = 0; r < dpiRepeat; r++) { //repeat pixels
-        temp_state = bitRead(temp_input[B], b); //get on or off from input
+      if (tempPixel >= 300) return temp_burst; //all nozzles are set, the last 4 bits are unused
+      temp_state = bitRead(temp_input[B], b); //get on or off from input
+      for (tempNozzle = dpiNozzle[tempPixel]; tempNozzle < dpiNozzle[tempPixel + 1]; tempNozzle++) { //all nozzles of this pixel
         bitWrite(temp_burst[nozzleTableAddress[tempNozzle]], nozzleTablePrimitive[tempNozzle], temp_state); //set nozzle in burst on or off
-        tempNozzle ++; //add one to nozzle
       }
+      tempPixel++;
+    }
+  }
+  return temp_burst;
+}
+uint16_t *DMAPrint::CompensateBurst(uint16_t temp_burst[22]) { //moves the drops of dead nozzles in a burst to working nozzles, done on the burst that is fired so every source of lines uses the current map
+  if (nozzleCompensation == 0) return temp_burst;
+  for (uint8_t r = 0; r < nozzleRemapCount; r++) {
+    if (temp_burst[nozzleRemapAddress[r]] & nozzleRemapBit[r]) {
+      temp_burst[nozzleRemapTargetAddress[r]] |= nozzleRemapTargetBit[r];
     }
   }
+  for (uint8_t a = 0; a < 22; a++) { //dead nozzles do not need to fire
+    temp_burst[a] &= ~nozzleDeadMask[a];
+  }
   return temp_burst;
 }
-void DMAPrint::SetDPI(uint16_t temp_dpi) { //takes dpi, does some maths on it and sets the resolution on decoding
-  if (temp_dpi <= 600) { //on valid dip (max is 600
-    dpiRepeat = 600 / temp_dpi; //calculate repeat value. Repeat is how often each pixel is repeated going from nozzle 0 to 299
-    dpi = 600 / dpiRepeat; //get actual DPI, based on input, rounding to nearest number that is a division from 600
+uint16_t DMAPrint::SetNozzleCompensation(uint8_t tempNozzleState[300]) { //builds the remap table from a TestHead map (0 for dead, 1 for working), returns the number of dead nozzles
+  uint16_t tempDead = 0;
+  nozzleRemapCount = 0;
+  for (uint8_t a = 0; a < 22; a++) {
+    nozzleDeadMask[a] = 0;
+  }
+  for (int16_t n = 0; n < 300; n++) {
+    if (tempNozzleState[n] == 1) continue;
+    tempDead++;
+    nozzleDeadMask[nozzleTableAddress[n]] |= 1 << nozzleTablePrimitive[n];
+    int16_t tempTarget = -1;
+    if (n >= 2 && tempNozzleState[n - 2] == 1) tempTarget = n - 2; //same row, one up
+    else if (n < 298 && tempNozzleState[n + 2] == 1) tempTarget = n + 2; //same row, one down
+    if (tempTarget >= 0 && nozzleRemapCount < NOZZLE_REMAP_MAX) {
+      nozzleRemapAddress[nozzleRemapCount] = nozzleTableAddress[n];
+      nozzleRemapBit[nozzleRemapCount] = 1 << nozzleTablePrimitive[n];
+      nozzleRemapTargetAddress[nozzleRemapCount] = nozzleTableAddress[tempTarget];
+      nozzleRemapTargetBit[nozzleRemapCount] = 1 << nozzleTablePrimitive[tempTarget];
+      nozzleRemapCount++;
+    }
+  }
+  return tempDead;
+}
+void DMAPrint::SetNozzleCompensationEnabled(uint8_t tempState) { //sets whether dead nozzles are compensated (1) or not (0)
+  if (tempState == 1) nozzleCompensation = 1;
+  else nozzleCompensation = 0;
+}
+uint8_t DMAPrint::GetNozzleCompensationEnabled(void) { //returns whether dead nozzles are compensated
+  return nozzleCompensation;
+}
+uint8_t DMAPrint::GetNozzleRemapCount(void) { //returns how many dead nozzles are moved to a working nozzle
+  return nozzleRemapCount;
+}
+void DMAPrint::SetDPI(uint16_t temp_dpi) { //takes dpi and builds the table of which nozzles each input pixel covers
+  if (temp_dpi >= 1 && temp_dpi <= 600) { //on valid dpi (max is 600)
+    dpi = temp_dpi;
+    //nozzle n prints pixel n * dpi / 600, so pixel p starts at nozzle p * 600 / dpi rounded up. Each pixel covers 600 / dpi
+    //nozzles, the remainder is added up and gives an extra nozzle each time it passes the dpi (Bresenham), so any dpi spreads
+    //evenly over the head without dividing per pixel
+    uint16_t temp_step = 600 / dpi;
+    uint16_t temp_remainder = 600 % dpi;
+    uint16_t temp_error = dpi - 1; //rounds the start of each pixel up
+    uint16_t temp_nozzle = 0;
+    for (uint16_t p = 0; p <= 300; p++) {
+      dpiNozzle[p] = temp_nozzle;
+      temp_nozzle += temp_step;
+      temp_error += temp_remainder;
+      if (temp_error >= dpi) {
+        temp_error -= dpi;
+        temp_nozzle++;
+      }
+      if (temp_nozzle > 300) temp_nozzle = 300; //pixels past the head print nothing
+    }
     //Serial.print("Setting DPI to: "); Serial.println(dpi);
   }
 }
 
+uint16_t DMAPrint::GetDPI(void) { //returns the actual DPI
+  return dpi;
+}
+
 void DMAPrint::DMASetPulseSplit(uint8_t tempSplit){ //sets the number of divisions (splits) in each pulse, 1 being no splits and 4 being 4 powerings per pulse
   tempSplit = constrain(tempSplit, 1, 4);
   pulseSplits = tempSplit;
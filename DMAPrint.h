@@ -47,10 +47,18 @@ class DMAPrint {
     void set(uint32_t tempPosition, uint8_t tempDataC, uint8_t tempDataD);
     void SetBurst(uint16_t temp_input[22], uint8_t temp_mode);
     void TestHead(uint8_t* temp_nozzle_state, uint8_t* tempAddressState, uint8_t* tempPrimitiveState);
+    uint8_t TestHeadAddress(uint8_t tempAddress, uint8_t* tempNozzleState);
     uint8_t TestDummy(uint8_t temp_dummy);
     void SingleNozzle(uint16_t temp_nozzle);
     int8_t Preheat(uint16_t temp_pulses);
     int8_t Prime(uint16_t temp_pulses);
+    void PulseTrain(uint16_t tempPulses, uint8_t tempMode);
+    void PulseTrainBurst(uint16_t temp_input[22], uint16_t tempPulses, uint8_t tempMode);
+    void PulseTrainUpdate(void);
+    void PulseTrainStop(void);
+    uint8_t PulseTrainBusy(void);
+    uint16_t PulseTrainGetLeft(void);
+    uint32_t PulseTrainGetFrames(void);
     uint8_t TestAddress(void); 
 
     void Burst(void);
@@ -72,14 +80,31 @@ class DMAPrint {
     uint32_t GetVoltageLogic(void);
     uint32_t GetVoltageHead(void);
     uint32_t GetVoltageAddress(void);
-    
+    int32_t CalculateTemperature(int32_t temp10x, int32_t tempTsr);
+    uint32_t CalculateVoltage(int32_t tempV);
+
+    void AdcUpdate(void);
+    void AdcStop(void);
+    void AdcSuspend(uint8_t tempState);
+    uint32_t AdcGetSamples(void);
+    int32_t GetTemperatureFiltered(void);
+    uint32_t GetVoltageLogicFiltered(void);
+    uint32_t GetVoltageHeadFiltered(void);
+
+    void PulseWidthUpdate(void);
+    void SetPulseWidthCompensation(uint8_t tempState);
+    uint8_t GetPulseWidthCompensation(void);
+    void SetPulseWidthTable(uint8_t tempIndex, uint16_t tempWidth);
+    uint16_t GetPulseWidth(void);
+    uint8_t GetPulseWidthIndex(void);
+
     void SetPrimitiveClock(uint8_t tempState);
     void SetPrimitivePins(uint16_t tempState);
     void SetAddressClock(uint8_t tempState);
     void SetAddressReset(uint8_t tempState);
     void SetEnable(uint8_t tempState);
     void SetEnableTemp(uint8_t tempState);
-    void EnableReset();
+    static void EnableReset();
 
     void ResetBurst(void);
     uint8_t GetPrimitive(uint16_t temp_nozzle);
@@ -88,7 +113,13 @@ class DMAPrint {
     uint16_t *ConvertB6RawToBurst(uint8_t temp_input[50], uint16_t temp_burst[22]);
     uint16_t *ConvertB6ToggleToBurst(uint8_t temp_input[50], uint16_t temp_burst[22]);
     uint16_t *ConvertB8ToBurst(uint8_t temp_input[38], uint16_t temp_burst[22]);
+    uint16_t *CompensateBurst(uint16_t temp_burst[22]);
+    uint16_t SetNozzleCompensation(uint8_t tempNozzleState[300]);
+    void SetNozzleCompensationEnabled(uint8_t tempState);
+    uint8_t GetNozzleCompensationEnabled(void);
+    uint8_t GetNozzleRemapCount(void);
     void SetDPI(uint16_t temp_dpi);
+    uint16_t GetDPI(void);
     void DMASetPulseSplit(uint8_t tempSplit);
     uint8_t DMAGetPulseSplit(void);
     uint8_t GetEnabledState();
@@ -104,6 +135,11 @@ class DMAPrint {
     static uint32_t dmaFrequency;
     static DMAChannel dma1, dma2, dma3;
     static void isr(void);
+    static void adcIsr0(void);
+    static void adcIsr1(void);
+    static void AdcFinish(void);
+    void DMAStart(uint8_t tempCopy);
+    void TestAddressNozzles(uint8_t tempAddress, uint8_t* tempNozzleState);
 };
 
 #endif
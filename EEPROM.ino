@@ -1,5 +1,8 @@
 /*
    EEPROM handles all storage for all functionality It can save, load and returns all values through functions.
+
+   All settings are kept in one packed config struct with a version number and a CRC16, so a half written or old config
+   is never applied. EEPROM.put only writes the bytes that changed, so saving an unchanged config costs no wear.
 */
 
 #include <EEPROM.h>
@@ -56,18 +59,172 @@ uint8_t eepromBufferMode;
 
 //Advanced configurations (1000-1098)
 #define EEPROM_PULSE_SPLITS 1000
+#define EEPROM_ROW_GAP 1010 //old location of the row gap, only read when there is no valid config
+int32_t eepromRowGap;
+
+//Config struct (1100-1198)
+#define EEPROM_CONFIG 1100
+#define EEPROM_CONFIG_VERSION 1 //raise this when the struct changes, old configs are then ignored
+#define EEPROM_CONFIG_TRIGGERS 9 //the number of trigger pins
+struct EepromConfig {
+  uint8_t version;
+  uint8_t size; //the size of the struct, as a second check on the layout
+  uint16_t dpi;
+  uint16_t density;
+  uint8_t printheadSide;
+  uint8_t pulseSplits;
+  uint8_t bufferMode;
+  uint8_t bufferUpdateMode;
+  uint8_t positionMode;
+  float encoderResolution;
+  int32_t virtualVelocity;
+  int32_t virtualAcceleration;
+  int32_t virtualDistance;
+  int32_t virtualResetPosition;
+  int32_t rowGap;
+  int32_t triggerStartOffset;
+  uint8_t triggerMode[EEPROM_CONFIG_TRIGGERS];
+  uint8_t triggerResistor[EEPROM_CONFIG_TRIGGERS];
+  uint8_t triggerPush;
+  uint16_t crc; //CRC16 over all bytes before it
+} __attribute__((packed));
+EepromConfig eepromConfig;
+
+//Drop counters (2400-3599)
+#define EEPROM_DROP_COUNTERS 2400 //lifetime drops of each nozzle, 4 bytes per nozzle
 
 //Eeprom version number variables (these are the values which need to be in each address to verify that the eeprom has HP45 standalone data in it)
 #define EEPROM_CHECK_BYTES 24 
 uint16_t eepromCheckByteAddress[EEPROM_CHECK_BYTES] = {0, 99, 199, 299, 399, 499, 599, 699, 799, 899, 999, 1099, 1199, 1299, 1399, 1499, 1599, 1699, 1799, 1899, 1999, 2099, 2199, 2299};
 uint8_t eepromCheckByteValues[EEPROM_CHECK_BYTES] = {15, 39, 11, 150, 243, 3, 121, 186, 201, 10, 25, 94, 251, 220, 5, 25, 63, 78, 159, 241, 5, 99, 51, 22};
 
-void EepromLoad() { //Loads all data from EEPROM
-
+uint8_t EepromLoad() { //Loads all data from EEPROM, returns 1 if a valid config was loaded
+  uint8_t tempValid = 0;
+  if (EepromCheckSaved() == 1) { //only load when HP45 data was saved before
+    tempValid = EepromLoadConfig();
+    if (tempValid == 0) EepromLoadRowGap(); //older firmware only saved the row gap
+    EepromLoadDropCounters();
+  }
+  return tempValid;
 }
 
 void EepromSave() { //Saves all data to EEPROM
+  EepromSaveConfig();
+  EepromSaveDropCounters();
+}
+
+uint8_t EepromReadConfig() { //reads the config struct, returns 0 if it is not a valid config
+  EEPROM.get(EEPROM_CONFIG, eepromConfig);
+  if (eepromConfig.version != EEPROM_CONFIG_VERSION || eepromConfig.size != sizeof(eepromConfig)) return 0;
+  if (eepromConfig.crc != EepromCrc16((uint8_t*)&eepromConfig, sizeof(eepromConfig) - 2)) return 0;
+  return 1;
+}
+
+uint8_t EepromLoadConfig() { //loads the config struct and applies it, returns 0 if no valid config was found
+  if (EepromReadConfig() == 0) return 0;
+
+  //every value goes through the same setter as its serial command, so it is checked the same way
+  dmaHP45.SetDPI(eepromConfig.dpi);
+  InkjetSetDensity(eepromConfig.density);
+  BurstBuffer.SetPrintMode(eepromConfig.printheadSide);
+  dmaHP45.DMASetPulseSplit(eepromConfig.pulseSplits);
+  BurstBuffer.SetMode(eepromConfig.bufferMode);
+  BufferSetUpdateMode(eepromConfig.bufferUpdateMode);
+  if (eepromConfig.positionMode == 1) PositionSetModeVirtual();
+  else PositionSetModeEncoder();
+  PositionSetEncoderResolution(eepromConfig.encoderResolution);
+  PositionSetVirtualVelocity(eepromConfig.virtualVelocity);
+  PositionSetVirtualAcceleration(eepromConfig.virtualAcceleration);
+  PositionSetVirtualDistance(eepromConfig.virtualDistance);
+  PositionVirtualSetStart(eepromConfig.virtualResetPosition);
+  PositionSetRowGap(eepromConfig.rowGap);
+  TriggerSetStartOffset(eepromConfig.triggerStartOffset);
+  for (uint8_t t = 0; t < EEPROM_CONFIG_TRIGGERS; t++) {
+    TriggerSetResistor(t, eepromConfig.triggerResistor[t]);
+    TriggerSetPinMode(t, eepromConfig.triggerMode[t]);
+  }
+  TriggerSetTriggerPush(eepromConfig.triggerPush);
+  return 1;
+}
+
+void EepromSaveConfig() { //collects all settings in the config struct and saves it (only changed bytes are written)
+  eepromConfig.version = EEPROM_CONFIG_VERSION;
+  eepromConfig.size = sizeof(eepromConfig);
+  eepromConfig.dpi = dmaHP45.GetDPI();
+  eepromConfig.density = inkjetDensity;
+  eepromConfig.printheadSide = BurstBuffer.GetPrintMode();
+  eepromConfig.pulseSplits = dmaHP45.DMAGetPulseSplit();
+  eepromConfig.bufferMode = BurstBuffer.GetMode();
+  eepromConfig.bufferUpdateMode = bufferUpdateMode;
+  eepromConfig.positionMode = PositionGetMode();
+  eepromConfig.encoderResolution = PositionGetEncoderResolution();
+  eepromConfig.virtualVelocity = PositionGetVirtualVelocity();
+  eepromConfig.virtualAcceleration = PositionGetVirtualAcceleration();
+  eepromConfig.virtualDistance = PositionGetVirtualDistance();
+  eepromConfig.virtualResetPosition = PositionVirtualGetStart();
+  eepromConfig.rowGap = PositionGetRowGap();
+  eepromConfig.triggerStartOffset = TriggerGetStartOffset();
+  for (uint8_t t = 0; t < EEPROM_CONFIG_TRIGGERS; t++) {
+    eepromConfig.triggerMode[t] = TriggerGetPinMode(t);
+    eepromConfig.triggerResistor[t] = TriggerGetResistor(t);
+  }
+  eepromConfig.triggerPush = TriggerGetTriggerPush();
+  eepromConfig.crc = EepromCrc16((uint8_t*)&eepromConfig, sizeof(eepromConfig) - 2);
+  EEPROM.put(EEPROM_CONFIG, eepromConfig);
+  EepromSetSaved();
+}
+
+void EepromSaveRowGap() { //saves only the row gap, the rest of the saved config stays as it was
+  if (EepromReadConfig() == 1) {
+    eepromConfig.rowGap = PositionGetRowGap();
+    eepromConfig.crc = EepromCrc16((uint8_t*)&eepromConfig, sizeof(eepromConfig) - 2);
+    EEPROM.put(EEPROM_CONFIG, eepromConfig);
+  }
+  else { //no config yet, the old location is loaded when there is no valid config
+    eepromRowGap = PositionGetRowGap();
+    EEPROM.put(EEPROM_ROW_GAP, eepromRowGap);
+  }
+  EepromSetSaved();
+}
+
+uint16_t EepromCrc16(uint8_t *temp_data, uint16_t temp_length) { //CRC16-CCITT (0x1021, starting at 0xFFFF)
+  uint16_t temp_crc = 0xFFFF;
+  for (uint16_t i = 0; i < temp_length; i++) {
+    temp_crc ^= uint16_t(temp_data[i]) << 8;
+    for (uint8_t b = 0; b < 8; b++) {
+      if (temp_crc & 0x8000) temp_crc = (temp_crc << 1) ^ 0x1021;
+      else temp_crc <<= 1;
+    }
+  }
+  return temp_crc;
+}
+
+void EepromLoadRowGap() { //loads the row gap from its old location and applies it to position
+  EEPROM.get(EEPROM_ROW_GAP, eepromRowGap);
+  if (eepromRowGap > 0) { //ignore values that were never written, position constrains the rest
+    PositionSetRowGap(eepromRowGap);
+  }
+}
+
+void EepromLoadDropCounters() { //loads the lifetime drops of each nozzle
+  for (uint16_t n = 0; n < 300; n++) {
+    EEPROM.get(EEPROM_DROP_COUNTERS + n * 4, dropNozzleTotal[n]);
+    if (dropNozzleTotal[n] == 0xFFFFFFFF) dropNozzleTotal[n] = 0; //never written
+  }
+}
+
+void EepromSaveDropCounters() { //saves the lifetime drops of each nozzle (only changed bytes are written)
+  for (uint16_t n = 0; n < 300; n++) {
+    EepromSaveDropCounter(n);
+  }
+  EepromSetSaved();
+  dropUnsaved = 0;
+  dropSaveLast = millis();
+  dropSaveNozzle = 300; //a save in the background is not needed anymore
+}
 
+void EepromSaveDropCounter(uint16_t temp_nozzle) { //saves the lifetime drops of one nozzle
+  EEPROM.put(EEPROM_DROP_COUNTERS + temp_nozzle * 4, dropNozzleTotal[temp_nozzle]);
 }
 
 uint8_t EepromCheckByteCollision(uint16_t inputByte) {
@@ -54,6 +54,8 @@
 #include "buffer.cpp"
 #include "Serialcom.cpp"
 #include "DMAPrint.h"
+#include "Profiler.h"
+#include "JobStore.h"
 
 #ifdef __AVR__
 #error "Sorry, HP45 controller only works on Teensy 3.5 due to clocks and required hardware"
@@ -78,19 +80,36 @@ SerialCommand Ser;
 //modification to circuit: clk moved from shared 21 with clr to 4
 
 //variables
+#define INKJET_DENSITY_MIN 1 //the lowest density in percent
+#define INKJET_DENSITY_MAX 1000 //the highest density in percent
 uint16_t inkjetDensity = 100; //percentage, how often the printhead should burst
-int32_t inkjetMinPosition[2], inkjetMaxPosition[2]; //where the inkjet needs to start and end
+volatile int32_t inkjetMinPosition[2], inkjetMaxPosition[2]; //where the inkjet needs to start and end
 uint8_t inkjetEnabled[2], inkjetEnabledHistory[2]; //whether a side a allowed to jew ink or not (+ history)
 int32_t CurrentPosition[2]; //odd and even position of the printhead
 int32_t CurrentVelocity; //the current velocity of the printhead
 int8_t CurrentDirection; //which direction the printhead is moving
-int8_t requiredPrintingDirection[2]; //the direction between the current point and the next point
-int32_t targetPosition[2]; //the position where the buffer needs to go next
-uint8_t nextState[2]; //handles how the next line in the buffer is used
+volatile int8_t requiredPrintingDirection[2]; //the direction between the current point and the next point
+volatile int32_t targetPosition[2]; //the position where the buffer needs to go next
+volatile uint8_t nextState[2]; //handles how the next line in the buffer is used
 uint16_t serialBufferCounter = 0; //counter for lines received, when target reached, return a WL over serial
 uint8_t serialBufferWLToggle = 1; //whether to respond with a WL when a threshold is reached
-uint8_t serialBufferFirst[2] = {1, 1}; //the first buffer entry is treated different
+volatile uint8_t serialBufferFirst[2] = {1, 1}; //the first buffer entry is treated different
 uint8_t inkjetHardwareEnabled = 1; //allows the inkjet functions to be disabled for debug purposes
+uint8_t bufferUpdateMode = 0; //whether buffer lines are advanced in the main loop (0) or in a timer interrupt (1)
+IntervalTimer bufferUpdateTimer; //the timer that advances the buffer lines in interrupt mode
+volatile uint8_t bufferUpdateLock = 0; //set while the main loop changes the buffer, the interrupt then waits for the next tick
+#define PRINT_SOURCE_SERIAL 0 //lines are sent over serial
+#define PRINT_SOURCE_FLASH 1 //lines are read from the job store on each trigger
+#define PRINT_SOURCE_SD 2 //lines are read from the open job file on the SD card on each trigger
+#define JOB_LINES_PER_UPDATE 16 //the most lines added from the job store per cycle
+uint8_t printSource = PRINT_SOURCE_SERIAL;
+uint8_t jobSelected = 0; //the job that is printed from the job store
+int32_t jobReadLine = -1; //the next line of the job to add to the buffer, -1 when no job is playing
+#define RASTER_MAX_REPEAT 1000 //the most times one SBN line can be repeated
+int32_t rasterStart = 0; //the position of the first raster line in microns
+uint16_t rasterLpi = 600; //lines per inch of raster lines
+int8_t rasterDirection = 1; //whether raster positions go up (1) or down (-1)
+uint32_t rasterLine = 0; //the number of the next raster line
 uint32_t cycleCounter; //counts the number of cycles the code can complete per second
 uint32_t cycleTarget; //when the next cycle count is performed
 uint8_t cycleCounterEnabled = 0; //whether the cycle counter posts or not
@@ -99,13 +118,83 @@ uint8_t burstOn = 0; //whether the printhead is currently printing or not
 uint32_t inkjetBurstDelay; //how long to wait between each burst
 uint32_t inkjetLastBurst; //when the last burst was
 uint16_t DataBurst[22]; //the printing burst for decoding
-uint16_t CurrentBurst[22]; //the current printing burst
+uint16_t CurrentBurst[22]; //the current printing burst, in interrupt mode only read or written with bufferUpdateLock set
 uint8_t NozzleState[300];
+uint8_t nozzleStateTested = 0; //whether NozzleState holds the result of a test
+uint16_t nozzleDeadCount = 0; //how many nozzles were dead when compensation was set
+uint32_t nozzleQuickTestInterval = 0; //time in milliseconds between testing the next address while not printing, 0 is off
+uint32_t nozzleQuickTestLast; //when the last address was tested
+uint8_t nozzleQuickTestAddress = 0; //the address tested next
 uint8_t AddressState[22];
 uint8_t PrimitiveState[14];
 
+//firing limit variables, a nozzle needs time to refill before it can fire again
+#define INKJET_FIRE_LIMIT_OFF 0 //no limit
+#define INKJET_FIRE_LIMIT_WARN 1 //fire anyway, only set the overspeed warning
+#define INKJET_FIRE_LIMIT_DROP 2 //drop the dots of nozzles that fired too recently, leaving every other dot at double speed
+uint32_t inkjetMinFirePeriod = 100; //the shortest time in microseconds between two drops of the same nozzle
+uint8_t inkjetFireLimitMode = INKJET_FIRE_LIMIT_WARN; //what happens when a nozzle fires too fast
+uint16_t inkjetFireBurst[22]; //the burst that is actually fired, after the limit is applied
+uint32_t inkjetNozzleLastFire[22][14]; //when each nozzle (address, primitive) last fired in microseconds
+uint8_t inkjetOverspeed = 0; //set when a nozzle was asked to fire too fast since the last status check
+uint32_t inkjetOverspeedCount = 0; //how many bursts had nozzles firing too fast
+
+//drop counter variables
+//each fired burst is added to a bit sliced counter, one 16 bit word per bit of the count for each address, so adding a burst
+//is a few logic operations per address instead of a loop over all nozzles. Each main loop, one address is folded into the 32 bit totals
+#define DROP_PLANES 8 //bits in the bit sliced counter, it can count 255 bursts before it needs to be folded
+#define DROP_VOLUME 32 //the estimated volume of a drop in picoliters
+#define DROP_SAVE_INTERVAL 600000 //time in milliseconds between saving the lifetime totals to EEPROM, only when not printing
+uint16_t dropPlanes[22][DROP_PLANES]; //the bit sliced counters
+uint8_t dropFoldAddress = 0; //which address is folded next
+uint32_t dropNozzleTotal[300]; //lifetime drops of each nozzle
+uint32_t dropJobTotal = 0; //drops since the last job reset
+uint8_t dropUnsaved = 0; //whether the lifetime totals changed since they were saved
+uint32_t dropSaveLast; //when the lifetime totals were last saved
+uint16_t dropSaveNozzle = 300; //the next nozzle whose total is saved, 300 when no save is running
+uint16_t dropTrainBurst[22]; //the nozzles each frame of the current pulse train fires, all 0 for a preheat
+uint32_t dropTrainFrames = 0; //the pulse train frames that were counted so far
+
+//spit variables, nozzles that were not used for a while get a few drops outside the job or at the spit position to keep them from drying out
+#define SPIT_DROPS 4 //how many drops each stale nozzle gets
+#define SPIT_JOB_MARGIN 2000 //how far in microns both rows need to be from the lines of the job to spit
+uint16_t spitNozzleMask[22]; //the primitives of each address that have a nozzle
+int32_t spitPosition = 0; //base position in microns where spitting is always allowed
+int32_t spitPositionWindow = 0; //how far in microns the base may be from the spit position, 0 is off
+uint32_t spitInterval = 0; //time in milliseconds a nozzle may stay unused before it is spit, 0 is off
+uint16_t spitBudget = 300; //the most nozzles that are spit in each interval
+uint16_t spitBudgetLeft = 0; //how many nozzles can still be spit in this interval
+uint32_t spitLast; //when the last interval started
+uint16_t spitFired[22]; //the nozzles that fired since the start of the interval
+uint16_t spitStale[22]; //the nozzles that need to be spit
+uint16_t spitBurst[22]; //the nozzles in the spit being fired
+uint32_t spitCount = 0; //how many nozzles were spit in total
+
+//idle preheat variables
+#define INKJET_IDLE_PREHEAT_INTERVAL 20 //time in milliseconds between each set of preheat pulses
+#define INKJET_IDLE_PREHEAT_PULSES 10 //how many short pulses are done each time
+int16_t inkjetIdlePreheatTemperature = 0; //below this temperature (in .1C) the head is kept warm while not printing, 0 is off
+uint32_t inkjetIdlePreheatLast; //when the last preheat pulses were done
+
+//buffer update variables
+#define BUFFER_UPDATE_MODE_LOOP 0 //lines are advanced once per main loop iteration
+#define BUFFER_UPDATE_MODE_ISR 1 //lines are advanced in a timer interrupt on the live position
+#define BUFFER_LOOKAHEAD_LINES 8 //how many lines a side can advance in one update when the head passed several at once
+#define BUFFER_UPDATE_INTERVAL 50 //time in microseconds between each line check in interrupt mode
+
+//burst statistics, used to see if bursts fire on time and the buffer keeps up with the head
+#define BURST_STAT_BINS 16 //histograms have a bin per power of 2, bin n holds 2^n up to 2^(n+1) (bin 0 also holds 0)
+uint32_t burstStatBursts; //number of bursts timed while printing
+uint32_t burstStatMisses; //bursts that were a full burst delay or more late (at least one burst was not fired)
+uint32_t burstStatLateMax; //the latest burst in microseconds
+uint32_t burstStatLateHistogram[BURST_STAT_BINS]; //how late bursts were after their scheduled time in microseconds
+uint32_t burstStatUnderruns; //how often a side came in printing range with nothing left to read in the buffer
+uint8_t burstStatUnderrunHistory[2]; //whether a side was in an underrun last update
+volatile uint32_t burstStatLinesSkipped; //lines that were passed without being printed, because the head passed several lines in one update
+volatile uint32_t burstStatOvershootMax; //the largest distance in microns the head was past a target when the line switched
+volatile uint32_t burstStatOvershootHistogram[BURST_STAT_BINS]; //how far the head was past the target when the line switched in microns
+
 //trigger variables
-#define TRIGGER_UPDATE_DELAY 1000
 uint8_t triggerWhileActive = 0; //if the trigger is active in a while loop or not. Does not turn 1 for a normal trigger
 
 //error variables
@@ -117,7 +206,7 @@ uint32_t errorTarget; //counter for updating led animations
 uint32_t errorDelay = 200; //time in milliseconds between each update
 uint8_t errorAnimation = 0; //state machine for the animations
 uint32_t checkTarget; //counter for performing checks
-uint32_t checkDelay = 5000; //the interval at which basic checks are performed in milliseconds.
+uint32_t checkDelay = 500; //the interval at which basic checks are performed in milliseconds.
 
 #define ERROR_LOGIC_VOLTAGE_LOW_BIT 0
 #define ERROR_LOGIC_VOLTAGE_HIGH_BIT 1
@@ -132,6 +221,9 @@ uint32_t checkDelay = 5000; //the interval at which basic checks are performed i
 #define ERROR_DUMMY2_NOT_FALLING 10
 
 #define WARNING_HEAD_TEMPERATURE_HIGH_BIT 0
+#define WARNING_TRIGGER_QUEUE_FULL_BIT 1
+#define WARNING_NOZZLE_OVERSPEED_BIT 2
+#define WARNING_JOB_RECORD_ABORTED_BIT 3
 
 #define LOGIC_LOWER_VOLTAGE 11000
 #define LOGIC_UPPER_VOLTAGE 13000
@@ -180,6 +272,7 @@ uint32_t tempTimer, tempDelay = 1000000;
 void setup() {
   BurstBuffer.ClearAll(); //reset the buffer
   dmaHP45.begin();
+  InkjetSetSpitMask();
 
   //TestFill(); //fill buffer with test program
   inkjetEnabled[0] = 0;
@@ -189,8 +282,14 @@ void setup() {
   nextState[0] = 0; nextState[1] = 0; //set next state to starting position
 
   pinMode(statusLed, OUTPUT); //set status led
-
-  delay(2500); //delay to give serial time to start on pc side
+#ifdef PROFILER_ENABLED
+  Profiler::Begin(); //start the cycle counter
+#endif
+  JobStore::Begin(); //find the stored jobs
+  SdBegin(); //look for the SD card
+  if (EepromLoad() == 0) { //load all saved settings, with a valid config the unit can start right away
+    delay(2500); //delay to give serial time to start on pc side
+  }
   Ser.Begin(); //start serial connection
   //GenerateNewRawTables(); //uncommment to make a new nozzle table with the variables given in tab "NewNozzleTable"
 }
@@ -201,7 +300,9 @@ void loop() {
 }
 
 void UpdateAll() { //update all time critical functions
+  PROFILER_START(PROFILER_POSITION_UPDATE);
   PositionUpdate(); //get new position
+  PROFILER_STOP(PROFILER_POSITION_UPDATE);
   //get all velocitys and positions
   CurrentPosition[0] = PositionGetRowPositionMicrons(0);
   CurrentPosition[1] = PositionGetRowPositionMicrons(1);
@@ -210,24 +311,53 @@ void UpdateAll() { //update all time critical functions
 
   //get inkjet values
   if (inkjetHardwareEnabled == 1) {
-    BufferUpdateValues(); //see if new values in the buffer need to be called
+    if (bufferUpdateMode == BUFFER_UPDATE_MODE_LOOP) { //in interrupt mode the lines are advanced by BufferUpdateInterrupt
+      PROFILER_START(PROFILER_BUFFER_UPDATE_VALUES);
+      BufferUpdateValues(CurrentPosition); //see if new values in the buffer need to be called
+      PROFILER_STOP(PROFILER_BUFFER_UPDATE_VALUES);
+    }
     BufferUpdateLoop(); //update buffer loop state
+    PROFILER_START(PROFILER_INKJET_UPDATE_BURST_DELAY);
     InkjetUpdateBurstDelay(); //calculate burst delay based on density and speed
+    PROFILER_STOP(PROFILER_INKJET_UPDATE_BURST_DELAY);
+    PROFILER_START(PROFILER_INKJET_UPDATE_BURST);
     InkjetUpdateBurst(); //check if the printhead needs to be on based on required direction, actual direction, start pos and end pos
+    PROFILER_STOP(PROFILER_INKJET_UPDATE_BURST);
 
     //status update
+    PROFILER_START(PROFILER_UPDATE_STATUS);
+    dmaHP45.AdcUpdate(); //sample the sense lines in the background when there is time
     UpdateStatus();
+    dmaHP45.PulseWidthUpdate(); //match the pulse width to the head temperature and voltage
+    InkjetUpdatePreheat(); //keep the head warm when not printing
+    InkjetUpdateSpit(); //keep unused nozzles from drying out
+    DropCountUpdate(); //fold the drop counters into the totals
+    NozzleUpdateQuickTest(); //test one address of the head now and then
+    PROFILER_STOP(PROFILER_UPDATE_STATUS);
   }
-
-  if (Ser.Update() >= 1) { //get serial, if more than 1, add new command
+  dmaHP45.PulseTrainUpdate(); //fire the next frame of a preheat, prime or spit train
+  DropCountTrain(); //count the frames it fired
+
+  PROFILER_START(PROFILER_SERIAL_UPDATE);
+  int16_t temp_serial = Ser.Update(); //get serial
+  PROFILER_STOP(PROFILER_SERIAL_UPDATE);
+  if (temp_serial >= 1) { //if more than 1, add new command
+    PROFILER_START(PROFILER_SERIAL_EXECUTE);
+    bufferUpdateLock = 1; //commands can change the buffer, keep the interrupt out
     SerialExecute(); //get command and execute it
+    bufferUpdateLock = 0;
+    PROFILER_STOP(PROFILER_SERIAL_EXECUTE);
   }
   SerialWLPush(); //check push Write Left requirements
+  JobUpdate(); //add lines from the job store to the buffer
+  SdUpdate(); //add lines from the SD card to the buffer
 
   //get SPI
 
   //Trigger update
+  PROFILER_START(PROFILER_UPDATE_TRIGGER);
   UpdateTrigger();
+  PROFILER_STOP(PROFILER_UPDATE_TRIGGER);
 
   //cycle counter
   UpdateCycle();
@@ -236,9 +366,17 @@ void UpdateAll() { //update all time critical functions
 ///----------------------------------------------------------
 void InkjetUpdateBurst() { //checks if the head is within range to burst (direction and position) and bursts the head is conditions are met
   uint8_t tempState_changed = 0; //value to indicate enabled states have changed
+  bufferUpdateLock = 1; //in interrupt mode the limits, direction and buffer change between lines, keep the interrupt out while they are used
   for (uint8_t s = 0; s <= 1; s++) {
     if (requiredPrintingDirection[s] == CurrentDirection && CurrentPosition[s] > inkjetMinPosition[s] && CurrentPosition[s] < inkjetMaxPosition[s] && CurrentVelocity != 0) { //if head is within the inkjet limits and direction matches and velocity is not 0
       inkjetEnabled[s] = 1; //direction and area match, enable head
+      if (BurstBuffer.ReadLeftSide(s) == 0) { //printing with nothing left to read, the buffer ran out
+        if (burstStatUnderrunHistory[s] == 0) burstStatUnderruns++; //count each underrun once
+        burstStatUnderrunHistory[s] = 1;
+      }
+      else {
+        burstStatUnderrunHistory[s] = 0;
+      }
       if (inkjetEnabledHistory[s] == 0) { //if history and current are not the same, mark change buffer
         inkjetEnabledHistory[s] = 1;
         tempState_changed = 1;
@@ -257,13 +395,19 @@ void InkjetUpdateBurst() { //checks if the head is within range to burst (direct
   if (tempState_changed == 1) { //if any of the states changed, request new data from the buffer with correct overlays
     BurstBuffer.GetBurst(CurrentBurst); //get new burst from the buffer
   }
+  bufferUpdateLock = 0;
   //check burst time conditions
   if (micros() - inkjetLastBurst > inkjetBurstDelay) { //if burst is required again based on time (updated regradless of burst conditions)
+    uint32_t temp_late = micros() - inkjetLastBurst - inkjetBurstDelay; //how long after the scheduled time this burst is
     inkjetLastBurst = micros();
+    if (burstOn == 1) { //only time bursts that follow a burst, the first burst of a print has no schedule
+      BurstStatAddLate(temp_late);
+    }
     if (inkjetEnabled[0] == 1 ||  inkjetEnabled[1] == 1) { //if the head is within bounds, burst head
       dmaHP45.SetEnable(1); //enable the head
       burstOn = 1;
-      dmaHP45.SetBurst(CurrentBurst, 1);
+      InkjetLimitBurst(micros()); //remove nozzles that have not refilled yet
+      dmaHP45.SetBurst(inkjetFireBurst, 1);
       dmaHP45.Burst(); //burst the printhead
     }
     else {
@@ -272,6 +416,222 @@ void InkjetUpdateBurst() { //checks if the head is within range to burst (direct
     }
   }
 }
+void InkjetLimitBurst(uint32_t temp_time) { //copies the current burst to the fire burst, checking each nozzle against the time it last fired
+  uint8_t temp_over = 0;
+  bufferUpdateLock = 1; //make sure the interrupt does not change the burst halfway through the copy, the rest only uses the copy
+  for (uint8_t a = 0; a < 22; a++) {
+    inkjetFireBurst[a] = CurrentBurst[a];
+  }
+  bufferUpdateLock = 0;
+  dmaHP45.CompensateBurst(inkjetFireBurst); //move the drops of dead nozzles, before the limit so the nozzles that take over are checked too
+  for (uint8_t a = 0; a < 22 && inkjetFireLimitMode != INKJET_FIRE_LIMIT_OFF; a++) { //with the limit off, the times are not needed
+    uint16_t temp_nozzles = inkjetFireBurst[a];
+    while (temp_nozzles != 0) { //only the nozzles that fire
+      uint8_t p = __builtin_ctz(temp_nozzles);
+      temp_nozzles &= temp_nozzles - 1;
+      if (temp_time - inkjetNozzleLastFire[a][p] < inkjetMinFirePeriod) { //fires again too soon
+        temp_over = 1;
+        if (inkjetFireLimitMode == INKJET_FIRE_LIMIT_DROP) {
+          inkjetFireBurst[a] &= ~(1 << p);
+          continue; //the nozzle does not fire, so its time stays
+        }
+      }
+      inkjetNozzleLastFire[a][p] = temp_time;
+    }
+  }
+  if (temp_over == 1) {
+    inkjetOverspeed = 1;
+    inkjetOverspeedCount++;
+    bitWrite(warningList, WARNING_NOZZLE_OVERSPEED_BIT, 1);
+  }
+
+  //remember what was fired
+  for (uint8_t a = 0; a < 22; a++) {
+    spitFired[a] |= inkjetFireBurst[a];
+  }
+  DropCountBurst(inkjetFireBurst);
+}
+uint32_t InkjetGetMaxVelocity() { //returns the highest velocity in mm/s at which no nozzle fires faster than the minimum fire period
+  if (inkjetMinFirePeriod == 0 || inkjetDensity == 0) return 0; //no limit
+  //velocity = 25.4 mm per inch / (period * dpi * density / 100)
+  return 2540000000ULL / (uint64_t(inkjetMinFirePeriod) * printheadDPI * inkjetDensity);
+}
+void InkjetSetDensity(int32_t temp_density) { //sets how often the printhead bursts in percent of the DPI
+  inkjetDensity = constrain(temp_density, INKJET_DENSITY_MIN, INKJET_DENSITY_MAX);
+}
+void DropCountBurst(uint16_t temp_burst[22]) { //adds one fired burst to the bit sliced counters
+  for (uint8_t a = 0; a < 22; a++) {
+    uint16_t temp_carry = temp_burst[a];
+    for (uint8_t k = 0; k < DROP_PLANES && temp_carry != 0; k++) { //ripple the carry through the bits
+      uint16_t temp_next = dropPlanes[a][k] & temp_carry;
+      dropPlanes[a][k] ^= temp_carry;
+      temp_carry = temp_next;
+    }
+  }
+}
+void DropCountBurstTimes(uint16_t temp_burst[22], uint32_t temp_times) { //adds a burst fired a number of times straight to the totals, for pulse trains
+  if (temp_times == 0) return;
+  for (uint8_t a = 0; a < 22; a++) {
+    uint16_t temp_nozzles = temp_burst[a];
+    while (temp_nozzles != 0) {
+      uint8_t p = __builtin_ctz(temp_nozzles);
+      temp_nozzles &= temp_nozzles - 1;
+      int16_t temp_nozzle = dmaHP45.GetNozzle(p, a);
+      if (temp_nozzle < 0) continue; //no nozzle there, no drop
+      dropNozzleTotal[temp_nozzle] += temp_times;
+      dropJobTotal += temp_times;
+      dropUnsaved = 1;
+    }
+  }
+}
+void DropCountTrain() { //counts the pulse train frames fired since the last call, also the ones before a train was stopped
+  uint32_t temp_frames = dmaHP45.PulseTrainGetFrames();
+  DropCountBurstTimes(dropTrainBurst, temp_frames - dropTrainFrames);
+  dropTrainFrames = temp_frames;
+}
+void DropCountTrainStart(uint16_t *temp_burst) { //counts what is left of the last pulse train and takes the nozzles of the next one, 0 for a train without drops
+  DropCountTrain();
+  for (uint8_t a = 0; a < 22; a++) {
+    if (temp_burst != 0) dropTrainBurst[a] = temp_burst[a];
+    else dropTrainBurst[a] = 0;
+  }
+}
+void DropCountUpdate() { //folds one address of the bit sliced counters into the totals, and saves the totals now and then
+  uint8_t a = dropFoldAddress;
+  dropFoldAddress++;
+  if (dropFoldAddress >= 22) dropFoldAddress = 0;
+  uint16_t temp_any = 0;
+  for (uint8_t k = 0; k < DROP_PLANES; k++) {
+    temp_any |= dropPlanes[a][k];
+  }
+  if (temp_any != 0) { //only unpack addresses that fired
+    for (uint8_t p = 0; p < 14; p++) {
+      if (bitRead(temp_any, p) == 0) continue;
+      uint32_t temp_count = 0;
+      for (uint8_t k = 0; k < DROP_PLANES; k++) {
+        temp_count |= uint32_t((dropPlanes[a][k] >> p) & 1) << k;
+      }
+      int16_t temp_nozzle = dmaHP45.GetNozzle(p, a);
+      if (temp_nozzle >= 0) dropNozzleTotal[temp_nozzle] += temp_count;
+      dropJobTotal += temp_count;
+    }
+    for (uint8_t k = 0; k < DROP_PLANES; k++) {
+      dropPlanes[a][k] = 0;
+    }
+    dropUnsaved = 1;
+  }
+
+  //the totals are saved one nozzle each loop, every changed byte waits for the EEPROM, so saving all at once would hold up a trigger or the next product
+  if (dropSaveNozzle < 300) {
+    if (burstOn == 0) {
+      EepromSaveDropCounter(dropSaveNozzle);
+      dropSaveNozzle++;
+      if (dropSaveNozzle >= 300) { //all saved
+        EepromSetSaved();
+        dropSaveLast = millis();
+      }
+    }
+  }
+  else if (dropUnsaved == 1 && burstOn == 0 && millis() - dropSaveLast > DROP_SAVE_INTERVAL) {
+    dropSaveNozzle = 0; //start saving, counts added from here on are saved the next time
+    dropUnsaved = 0;
+  }
+}
+void DropCountRespond(uint8_t temp_page) { //responds with drop counters, page 0 for totals, page 1 to 6 for 50 nozzles each
+  if (temp_page == 0) {
+    uint64_t temp_lifetime = 0;
+    for (uint16_t n = 0; n < 300; n++) {
+      temp_lifetime += dropNozzleTotal[n];
+    }
+    int32_t temp_values[4] = {int32_t(dropJobTotal), int32_t((uint64_t(dropJobTotal) * DROP_VOLUME) / 1000), //job drops and nanoliters
+                              int32_t((temp_lifetime * DROP_VOLUME) / 1000000), int32_t(temp_lifetime / 1000)}; //lifetime microliters and thousands of drops
+    Ser.RespondValues("GDRC", 0, temp_values, 4);
+  }
+  else if (temp_page <= 6) {
+    int32_t temp_values[50];
+    for (uint8_t n = 0; n < 50; n++) {
+      temp_values[n] = dropNozzleTotal[(temp_page - 1) * 50 + n];
+    }
+    Ser.RespondValues("GDRC", temp_page, temp_values, 50);
+  }
+}
+void NozzleUpdateQuickTest() { //tests the nozzles of one address at a time while not printing, so the nozzle map stays current
+  if (nozzleQuickTestInterval == 0 || nozzleStateTested == 0) return; //only keep a full test up to date
+  if (millis() - nozzleQuickTestLast < nozzleQuickTestInterval) return;
+  if (burstOn == 1 || inkjetEnabled[0] == 1 || inkjetEnabled[1] == 1) return; //never while printing
+  if (errorList != 0 || dmaHP45.PulseTrainBusy() == 1) return;
+  if (dmaHP45.AdcGetSamples() == 0 || dmaHP45.GetTemperatureFiltered() == -2) return; //no head
+  nozzleQuickTestLast = millis();
+  uint8_t temp_changed = dmaHP45.TestHeadAddress(nozzleQuickTestAddress, NozzleState);
+  nozzleQuickTestAddress++;
+  if (nozzleQuickTestAddress >= 22) nozzleQuickTestAddress = 0;
+  if (temp_changed > 0 && dmaHP45.GetNozzleCompensationEnabled() == 1) { //keep the compensation in line with the head
+    nozzleDeadCount = dmaHP45.SetNozzleCompensation(NozzleState);
+  }
+}
+void InkjetUpdateSpit() { //spits nozzles that were not fired for the spit interval, only outside the print window
+  if (spitInterval == 0) return;
+  if (millis() - spitLast >= spitInterval) { //new interval, everything that was not fired in the last one is stale
+    spitLast = millis();
+    for (uint8_t a = 0; a < 22; a++) {
+      spitStale[a] |= ~spitFired[a] & spitNozzleMask[a];
+      spitFired[a] = 0;
+    }
+    spitBudgetLeft = spitBudget;
+  }
+  if (spitBudgetLeft == 0) return;
+  if (burstOn == 1 || inkjetEnabled[0] == 1 || inkjetEnabled[1] == 1) return; //never spit in the print window
+  if (errorList != 0 || dmaHP45.PulseTrainBusy() == 1) return;
+  if (InkjetSpitAllowed() == 0) return; //the drops could land on the product
+
+  //pick as many stale nozzles as the budget allows
+  uint16_t temp_count = 0;
+  for (uint8_t a = 0; a < 22; a++) {
+    uint16_t temp_stale = spitStale[a];
+    while (temp_stale != 0 && temp_count + __builtin_popcount(temp_stale) > spitBudgetLeft) { //drop the highest nozzles until it fits
+      temp_stale &= ~(1 << (31 - __builtin_clz(temp_stale)));
+    }
+    spitBurst[a] = temp_stale;
+    spitStale[a] &= ~temp_stale;
+    temp_count += __builtin_popcount(temp_stale);
+  }
+  if (temp_count == 0) return;
+  spitBudgetLeft -= temp_count;
+  spitCount += temp_count;
+
+  uint8_t temp_enabled = dmaHP45.GetEnabledState();
+  dmaHP45.SetEnable(1); //temporarily enable head, the pulse train keeps it enabled until it is done
+  DropCountTrainStart(spitBurst);
+  dmaHP45.PulseTrainBurst(spitBurst, SPIT_DROPS, 1);
+  dmaHP45.SetEnable(temp_enabled); //set enable state to previous
+}
+uint8_t InkjetSpitAllowed() { //returns 1 if the head is at the spit position, or both rows are clear of the job
+  if (spitPositionWindow > 0 && abs(PositionGetBasePositionMicrons() - spitPosition) <= spitPositionWindow) return 1;
+  if (BurstBuffer.OutsideJob(CurrentPosition[0], SPIT_JOB_MARGIN) == 1 && BurstBuffer.OutsideJob(CurrentPosition[1], SPIT_JOB_MARGIN) == 1) return 1;
+  return 0;
+}
+void InkjetSetSpitMask() { //marks the primitives of each address that have a nozzle, the rest is never spit
+  for (uint8_t a = 0; a < 22; a++) {
+    spitNozzleMask[a] = 0;
+  }
+  for (uint16_t n = 0; n < 300; n++) {
+    spitNozzleMask[dmaHP45.GetAddress(n)] |= 1 << dmaHP45.GetPrimitive(n);
+  }
+}
+void InkjetUpdatePreheat() { //does short pulses on a cold head while not printing, so the first lines print like the rest
+  if (inkjetIdlePreheatTemperature <= 0 || burstOn == 1 || errorList != 0) return;
+  if (dmaHP45.AdcGetSamples() == 0) return; //no temperature known yet
+  if (dmaHP45.PulseTrainBusy() == 1) return; //still preheating or priming
+  if (millis() - inkjetIdlePreheatLast < INKJET_IDLE_PREHEAT_INTERVAL) return;
+  inkjetIdlePreheatLast = millis();
+  int32_t temp_temperature = dmaHP45.GetTemperatureFiltered();
+  if (temp_temperature == -2 || temp_temperature >= inkjetIdlePreheatTemperature) return; //no head or warm enough
+  uint8_t temp_enabled = dmaHP45.GetEnabledState();
+  dmaHP45.SetEnable(1); //temporarily enable head
+  DropCountTrainStart(0); //short pulses fire no drops
+  dmaHP45.Preheat(INKJET_IDLE_PREHEAT_PULSES);
+  dmaHP45.SetEnable(temp_enabled); //set enable state to previous
+}
 void InkjetUpdateBurstDelay() { //recalculates burst delay
   if (CurrentVelocity != 0) { //if velocity is more than 0
     float temp_dpi = float(printheadDPI) * float(inkjetDensity); //calculate actual DPI
@@ -284,66 +644,139 @@ void InkjetUpdateBurstDelay() { //recalculates burst delay
     inkjetBurstDelay = long(temp_calc); //write to the variable
   }
 }
-void BufferUpdateValues() { //checks if the next positions in the buffer can be called
+void BufferUpdateValues(int32_t temp_position[2]) { //checks if the next positions in the buffer can be called
   for (uint8_t s = 0; s <= 1; s++) { //check if the burst needs to change (for odd and even)
-    uint8_t update_values = 0;
-    //if there is a first line on the given side, force an update every cycle
-    if (serialBufferFirst[s] == 1) { //if the pin is on read first, force a check constantly
-      update_values = 1; //force the check of the values
+    //when the head passed several lines since the last update, keep advancing until the buffer has caught up with the head
+    for (uint8_t l = 0; l < BUFFER_LOOKAHEAD_LINES; l++) {
+      if (BufferUpdateSide(s, temp_position[s]) == 0) break; //stop when no new target was set
+      if (l > 0) burstStatLinesSkipped++; //the line before this one was passed without printing
     }
-    else if (requiredPrintingDirection[s] == -1) { //if required direction is negative
-      if (CurrentPosition[s] < targetPosition[s]) { //check if new position requirement is met
-        update_values = 1; //set buffer to next position
-      }
+  } //end of s(ide) for loop
+}
+uint8_t BufferUpdateSide(uint8_t s, int32_t temp_position) { //checks if one side needs to go to the next line, returns 1 if a new target was set
+  uint8_t update_values = 0;
+  uint8_t temp_advanced = 0;
+  //if there is a first line on the given side, force an update every cycle
+  if (serialBufferFirst[s] == 1) { //if the pin is on read first, force a check constantly
+    update_values = 1; //force the check of the values
+  }
+  else if (requiredPrintingDirection[s] == -1) { //if required direction is negative
+    if (temp_position < targetPosition[s]) { //check if new position requirement is met
+      update_values = 1; //set buffer to next position
+      BurstStatAddOvershoot(targetPosition[s] - temp_position);
     }
-    else { //if required direction is positive
-      if (CurrentPosition[s] > targetPosition[s]) { //check if new position requirement is met
-        update_values = 1; //set buffer to next position
-      }
+  }
+  else { //if required direction is positive
+    if (temp_position > targetPosition[s]) { //check if new position requirement is met
+      update_values = 1; //set buffer to next position
+      BurstStatAddOvershoot(temp_position - targetPosition[s]);
     }
+  }
 
-    if (update_values == 1) {//if a position in the buffer needs to advance
-      //first, modify the inkjet burst data to the now reached position, regardless of whether a further line is available
-      //(any last all off command should never be ignored)
-      if (BurstBuffer.ReadLeftSide(s) > 0 && nextState[s] == 0) { //if there is space left to read
-        nextState[s] = 1; //set next state to 1, so other target functions can happen if possible
-        BurstBuffer.Next(s); //go to next position in the buffer
-        BurstBuffer.GetBurst(CurrentBurst); //active the burst on the now reached position (do so regardless of new line)
-        //Serial.print("Buffer Next: "); Serial.print(s); Serial.print(", Pos: "); Serial.println(targetPosition[s]);
-      }
+  if (update_values == 1) {//if a position in the buffer needs to advance
+    //first, modify the inkjet burst data to the now reached position, regardless of whether a further line is available
+    //(any last all off command should never be ignored)
+    if (BurstBuffer.ReadLeftSide(s) > 0 && nextState[s] == 0) { //if there is space left to read
+      nextState[s] = 1; //set next state to 1, so other target functions can happen if possible
+      BurstBuffer.Next(s); //go to next position in the buffer
+      BurstBuffer.GetBurst(CurrentBurst); //active the burst on the now reached position (do so regardless of new line)
+      //Serial.print("Buffer Next: "); Serial.print(s); Serial.print(", Pos: "); Serial.println(targetPosition[s]);
+    }
 
-      if (BurstBuffer.ReadLeftSide(s) > 0 && nextState[s] == 1) { //if there is space left to read for the look ahead function
-        int32_t temp_ahead_pos; //get old position stored before it is overwritten
-        temp_ahead_pos = BurstBuffer.LookAheadPosition(s);
+    if (BurstBuffer.ReadLeftSide(s) > 0 && nextState[s] == 1) { //if there is space left to read for the look ahead function
+      int32_t temp_ahead_pos; //get old position stored before it is overwritten
+      temp_ahead_pos = BurstBuffer.LookAheadPosition(s);
 
-        if (serialBufferFirst[s] == 1) { //if not first line, use last position in the buffer
-          targetPosition[s] = CurrentPosition[s];
-          serialBufferFirst[s] = 0; //set first to 0 to stop future use
-        }
+      if (serialBufferFirst[s] == 1) { //if not first line, use last position in the buffer
+        targetPosition[s] = temp_position;
+        serialBufferFirst[s] = 0; //set first to 0 to stop future use
+      }
 
-        //Serial.print("look ahead: "); Serial.println(temp_ahead_pos);
-        if (temp_ahead_pos - targetPosition[s] >= 0) requiredPrintingDirection[s] = 1; //determine required direction
-        else requiredPrintingDirection[s] = -1;
-        //set the inkjet limits, the coordinates where the printhead is allowed to print
-        if (temp_ahead_pos < targetPosition[s]) { //determine smallest value
-          inkjetMinPosition[s] = temp_ahead_pos;
-          inkjetMaxPosition[s] = targetPosition[s];
-        }
-        else {
-          inkjetMinPosition[s] = targetPosition[s];
-          inkjetMaxPosition[s] = temp_ahead_pos;
-        }
-        targetPosition[s] = temp_ahead_pos; //set new position
-        nextState[s] = 0; //set next state to next line again
+      //Serial.print("look ahead: "); Serial.println(temp_ahead_pos);
+      if (temp_ahead_pos - targetPosition[s] >= 0) requiredPrintingDirection[s] = 1; //determine required direction
+      else requiredPrintingDirection[s] = -1;
+      //set the inkjet limits, the coordinates where the printhead is allowed to print
+      if (temp_ahead_pos < targetPosition[s]) { //determine smallest value
+        inkjetMinPosition[s] = temp_ahead_pos;
+        inkjetMaxPosition[s] = targetPosition[s];
       }
-      //if the buffer is completely empty on both sides, set buffer first to 1 to allow for a clean restart when the buffer refills
-      if (BurstBuffer.ReadLeftSide(0) == 0 && BurstBuffer.ReadLeftSide(1) == 0) { //if read buffer is completely empty
-        serialBufferFirst[0] = 1;
-        serialBufferFirst[1] = 1;
+      else {
+        inkjetMinPosition[s] = targetPosition[s];
+        inkjetMaxPosition[s] = temp_ahead_pos;
       }
+      targetPosition[s] = temp_ahead_pos; //set new position
+      nextState[s] = 0; //set next state to next line again
+      temp_advanced = 1;
+    }
+    //if the buffer is completely empty on both sides, set buffer first to 1 to allow for a clean restart when the buffer refills
+    if (BurstBuffer.ReadLeftSide(0) == 0 && BurstBuffer.ReadLeftSide(1) == 0) { //if read buffer is completely empty
+      serialBufferFirst[0] = 1;
+      serialBufferFirst[1] = 1;
+    }
 
+  }
+  return temp_advanced;
+}
+void BufferUpdateInterrupt() { //timer interrupt, advances the buffer as soon as the live position crosses the next target
+  if (bufferUpdateLock == 1) return; //the main loop is changing the buffer, check again next tick
+  int32_t temp_position[2];
+  temp_position[0] = PositionGetRowPositionMicronsLive(0);
+  temp_position[1] = PositionGetRowPositionMicronsLive(1);
+  BufferUpdateValues(temp_position); //advance all crossed lines, the burst is handed to the DMA through CurrentBurst
+}
+void BufferSetUpdateMode(uint8_t temp_mode) { //set whether lines are advanced in the main loop (0) or in a timer interrupt (1)
+  if (temp_mode == BUFFER_UPDATE_MODE_ISR) {
+    bufferUpdateMode = BUFFER_UPDATE_MODE_ISR;
+    bufferUpdateTimer.priority(128); //below the DMA and encoder interrupts
+    bufferUpdateTimer.begin(BufferUpdateInterrupt, BUFFER_UPDATE_INTERVAL);
+  }
+  else if (temp_mode == BUFFER_UPDATE_MODE_LOOP) {
+    bufferUpdateTimer.end();
+    bufferUpdateMode = BUFFER_UPDATE_MODE_LOOP;
+  }
+}
+uint8_t BurstStatBin(uint32_t temp_value) { //returns the histogram bin of a value (log2, limited to the last bin)
+  if (temp_value == 0) return 0;
+  uint8_t temp_bin = 31 - __builtin_clz(temp_value);
+  if (temp_bin >= BURST_STAT_BINS) temp_bin = BURST_STAT_BINS - 1;
+  return temp_bin;
+}
+void BurstStatAddLate(uint32_t temp_late) { //adds how late a burst was to the statistics
+  burstStatBursts++;
+  if (temp_late >= inkjetBurstDelay) burstStatMisses++; //a full burst late, a burst was not printed
+  if (temp_late > burstStatLateMax) burstStatLateMax = temp_late;
+  burstStatLateHistogram[BurstStatBin(temp_late)]++;
+}
+void BurstStatAddOvershoot(uint32_t temp_overshoot) { //adds how far the head was past a target on a line switch to the statistics
+  if (temp_overshoot > burstStatOvershootMax) burstStatOvershootMax = temp_overshoot;
+  burstStatOvershootHistogram[BurstStatBin(temp_overshoot)]++;
+}
+void BurstStatReset() { //resets all burst statistics
+  burstStatBursts = 0;
+  burstStatMisses = 0;
+  burstStatLateMax = 0;
+  burstStatUnderruns = 0;
+  burstStatLinesSkipped = 0;
+  burstStatOvershootMax = 0;
+  for (uint8_t b = 0; b < BURST_STAT_BINS; b++) {
+    burstStatLateHistogram[b] = 0;
+    burstStatOvershootHistogram[b] = 0;
+  }
+}
+void BurstStatRespond(uint8_t temp_page) { //responds with a page of burst statistics, 0 for totals, 1 for the late histogram, 2 for the overshoot histogram
+  if (temp_page == 0) {
+    int32_t temp_values[6] = {int32_t(burstStatBursts), int32_t(burstStatMisses), int32_t(burstStatLateMax),
+                              int32_t(burstStatUnderruns), int32_t(burstStatLinesSkipped), int32_t(burstStatOvershootMax)};
+    Ser.RespondValues("GBST", 0, temp_values, 6);
+  }
+  else if (temp_page == 1 || temp_page == 2) {
+    int32_t temp_values[BURST_STAT_BINS];
+    for (uint8_t b = 0; b < BURST_STAT_BINS; b++) {
+      if (temp_page == 1) temp_values[b] = burstStatLateHistogram[b];
+      else temp_values[b] = burstStatOvershootHistogram[b];
     }
-  } //end of s(ide) for loop
+    Ser.RespondValues("GBST", temp_page, temp_values, BURST_STAT_BINS);
+  }
 }
 void BufferUpdateLoop() { //checks if the buffer looped, forcing a position reset
   static uint8_t bufferLoopHistory = 0;
@@ -357,14 +790,96 @@ void BufferUpdateLoop() { //checks if the buffer looped, forcing a position rese
   }
 }
 void BufferReset(){ //savely resets the buffer in a way that allows for a stable restart
+  uint8_t temp_lock = bufferUpdateLock; //keep the interrupt out, also when called from within a locked command
+  bufferUpdateLock = 1;
   BurstBuffer.Reset(); //reset the buffer
   serialBufferFirst[0] = 1; //set buffers to firstline
   serialBufferFirst[1] = 1; //set buffers to firstline
+  bufferUpdateLock = temp_lock;
 }
 void BufferClear(){ //savely clears the buffer in a way that allows for a stable restart
+  uint8_t temp_lock = bufferUpdateLock; //keep the interrupt out, also when called from within a locked command
+  bufferUpdateLock = 1;
   BurstBuffer.ClearAll(); //clear all data in the buffer
   serialBufferFirst[0] = 1; //set buffers to firstline
   serialBufferFirst[1] = 1; //set buffers to firstline
+  bufferUpdateLock = temp_lock;
+}
+int32_t BufferAddLine(int32_t temp_position, uint16_t temp_burst[22]) { //adds a received line to the buffer, or to flash while recording a job. Returns -1 if it did not fit
+  if (JobStore::GetRecording() == 1) { //while recording a job, lines go to flash
+    if (JobRecordAllowed() == 0) { //flash writes stop all interrupts, a print started since recording began
+      JobStore::RecordAbort(); //without writing the directory, that too is a flash write
+      bitWrite(warningList, WARNING_JOB_RECORD_ABORTED_BIT, 1);
+      return -1;
+    }
+    return JobStore::RecordAdd(temp_position, temp_burst);
+  }
+  return BurstBuffer.Add(temp_position, temp_burst);
+}
+uint8_t JobRecordAllowed() { //returns 1 if nothing is printing or waiting to print, flash writes stop all interrupts and would lose encoder pulses and triggers
+  if (inkjetEnabled[0] == 1 || inkjetEnabled[1] == 1 || burstOn == 1) return 0;
+  if (TriggerQueueGetCount() != 0) return 0;
+  return 1;
+}
+int32_t RasterGetPosition(uint32_t temp_line) { //returns the position of a raster line in microns, from the start, LPI and direction
+  int32_t temp_offset = (uint64_t(temp_line) * 25400000 / rasterLpi + 500) / 1000; //calculated from the line number in nanometers, so lines do not drift
+  return rasterStart + temp_offset * rasterDirection;
+}
+void BufferSelectSlot(uint8_t temp_slot) { //savely switches the buffer to another slot, reading starts at the start of the slot
+  uint8_t temp_lock = bufferUpdateLock; //keep the interrupt out, also when called from within a locked command
+  bufferUpdateLock = 1;
+  BurstBuffer.SelectSlot(temp_slot);
+  serialBufferFirst[0] = 1; //set buffers to firstline
+  serialBufferFirst[1] = 1; //set buffers to firstline
+  bufferUpdateLock = temp_lock;
+}
+void BufferSeek(int32_t temp_position, int32_t temp_lines[2]) { //savely moves both sides to the line covering a base position, to resume a job there
+  uint8_t temp_lock = bufferUpdateLock; //keep the interrupt out, also when called from within a locked command
+  bufferUpdateLock = 1;
+  int32_t temp_base = PositionGetBasePositionMicrons();
+  for (uint8_t s = 0; s <= 1; s++) {
+    int32_t temp_row_offset = PositionGetRowPositionMicrons(s) - temp_base; //each side is its row gap apart from the base
+    temp_lines[s] = BurstBuffer.Seek(s, temp_position + temp_row_offset);
+    serialBufferFirst[s] = 1; //start from the found line as if it was the first
+    nextState[s] = 0;
+  }
+  bufferUpdateLock = temp_lock;
+}
+void BufferStartJob(int8_t temp_slot) { //prepares the buffer for a new job on a trigger, from the print source, in the given slot (-1 keeps the slot)
+  if (temp_slot >= 0 && temp_slot != BurstBuffer.GetSlot()) {
+    BufferSelectSlot(temp_slot);
+  }
+  if (printSource == PRINT_SOURCE_FLASH) { //print the selected job from flash
+    JobStart();
+  }
+  else if (printSource == PRINT_SOURCE_SD) { //print the open job file from the SD card
+    SdStart();
+  }
+  else if (BurstBuffer.GetMode() == 1 || BurstBuffer.GetMode() == 2) { //only reset the buffer is the printing mode is static or looping
+    BufferReset(); //reset the buffer
+  }
+}
+void JobStart() { //clears the buffer and starts adding the selected job from its first line
+  BufferClear();
+  if (JobStore::GetJobLines(jobSelected) > 0) jobReadLine = 0;
+  else jobReadLine = -1;
+}
+void JobUpdate() { //adds lines of the playing job to the buffer while there is space
+  if (jobReadLine < 0) return;
+  int32_t temp_position;
+  uint16_t temp_burst[22];
+  uint8_t temp_lock = bufferUpdateLock;
+  bufferUpdateLock = 1;
+  for (uint8_t l = 0; l < JOB_LINES_PER_UPDATE; l++) {
+    if (BurstBuffer.WriteLeft() <= 0) break; //buffer full, continue when lines are used
+    if (JobStore::GetLine(jobSelected, jobReadLine, &temp_position, temp_burst) == 0) { //end of the job
+      jobReadLine = -1;
+      break;
+    }
+    BurstBuffer.Add(temp_position, temp_burst);
+    jobReadLine++;
+  }
+  bufferUpdateLock = temp_lock;
 }
 void SerialExecute() { //on 1 in serial update, get values and execute commands
   //inkjetLineNumber = Ser.GetLineNumber(); //get line number
@@ -398,15 +913,40 @@ void SerialExecute() { //on 1 in serial update, get values and execute commands
         //  Serial.print(CurrentBurst[B]); Serial.print(" ");
         //}
         //Serial.println("");
-        BurstBuffer.Add(inkjetSmallValue, DataBurst);
+        BufferAddLine(inkjetSmallValue, DataBurst);
+      } break;
+    case 5456462: { //SBN, send buffer next, a raster line at the next raster position
+        dmaHP45.ConvertB6RawToBurst(inkjetRaw, DataBurst);
+        inkjetSmallValue = constrain(inkjetSmallValue, 1, RASTER_MAX_REPEAT); //the small value is optional, it repeats the line
+        for (int32_t r = 0; r < inkjetSmallValue; r++) {
+          if (BufferAddLine(RasterGetPosition(rasterLine), DataBurst) < 0) break; //full, the host resends from the WL
+          rasterLine++;
+        }
+      } break;
+    case 1397904212: { //SRST, set raster start
+        rasterStart = inkjetSmallValue;
+        rasterLine = 0;
+      } break;
+    case 1397510217: { //SLPI, set raster LPI
+        rasterLpi = constrain(inkjetSmallValue, 1, 10000);
+      } break;
+    case 1397900370: { //SRDR, set raster direction
+        if (inkjetSmallValue < 0) rasterDirection = -1;
+        else rasterDirection = 1;
+      } break;
+    case 1196577620: { //GRST, get raster state
+        int32_t temp_values[5] = {rasterStart, rasterLpi, rasterDirection, int32_t(rasterLine), RasterGetPosition(rasterLine)};
+        Ser.RespondValues("GRST", 0, temp_values, 5);
       } break;
     case 5456468: { //SBT, send buffer toggle
 
       } break;
     case 5456210: { //SAR, send asap raw
         dmaHP45.ConvertB6RawToBurst(inkjetRaw, DataBurst);
+        dmaHP45.CompensateBurst(DataBurst);
         dmaHP45.SetBurst(DataBurst, 1);
         dmaHP45.Burst();
+        if (dmaHP45.GetEnabledState() == 1) DropCountBurst(DataBurst);
       } break;
     case 5456212: { //SAT, send asap toggle
 
@@ -415,6 +955,7 @@ void SerialExecute() { //on 1 in serial update, get values and execute commands
         inkjetSmallValue = constrain(inkjetSmallValue, 0, 25000);
         uint8_t temp_enabled = dmaHP45.GetEnabledState();
         dmaHP45.SetEnable(1); //temporarily enable head
+        DropCountTrainStart(0); //short pulses fire no drops
         dmaHP45.Preheat(inkjetSmallValue); //preheat for n times
         dmaHP45.SetEnable(temp_enabled); //set enable state to previous
       } break;
@@ -422,9 +963,21 @@ void SerialExecute() { //on 1 in serial update, get values and execute commands
         inkjetSmallValue = constrain(inkjetSmallValue, 0, 25000);
         uint8_t temp_enabled = dmaHP45.GetEnabledState();
         dmaHP45.SetEnable(1); //temporarily enable head
-        dmaHP45.Prime(inkjetSmallValue); //preheat for n times
+        uint16_t temp_all[22];
+        for (uint8_t a = 0; a < 22; a++) {
+          temp_all[a] = 16383; //every primitive, the empty ones are not counted
+        }
+        DropCountTrainStart(temp_all); //the frames are counted as they are fired, so a stopped prime is not over counted
+        dmaHP45.Prime(inkjetSmallValue); //prime for n times
         dmaHP45.SetEnable(temp_enabled); //set enable state to previous
       } break;
+    case 1196446803: { //GPTS, get pulse train state
+        int32_t temp_values[2] = {dmaHP45.PulseTrainBusy(), dmaHP45.PulseTrainGetLeft()};
+        Ser.RespondValues("GPTS", 0, temp_values, 2);
+      } break;
+    case 1347703636: { //PTST, pulse train stop
+        dmaHP45.PulseTrainStop();
+      } break;
     case 5523524: { //THD, Test head
         inkjetSmallValue = constrain(inkjetSmallValue, 0, 1);
         TestPrintheadFunctions(inkjetSmallValue); //test printhead
@@ -449,7 +1002,7 @@ void SerialExecute() { //on 1 in serial update, get values and execute commands
         dmaHP45.SetDPI(inkjetSmallValue); //set DPI with small value
       } break;
     case 5456974: { //SDN, Set Density
-        inkjetDensity = inkjetSmallValue; //set density with small value
+        InkjetSetDensity(inkjetSmallValue); //set density with small value
       } break;
     case 1397967172: { //SSID, Set Side
         BurstBuffer.SetPrintMode(inkjetSmallValue);
@@ -457,6 +1010,9 @@ void SerialExecute() { //on 1 in serial update, get values and execute commands
     case 1112362820: { //BMOD, buffer mode
         BurstBuffer.SetMode(inkjetSmallValue); //set mode with small value
       } break;
+    case 1112887373: { //BUPM, buffer update mode
+        BufferSetUpdateMode(inkjetSmallValue);
+      } break;
     case 4346444: { //BRL, Buffer, read left
         Ser.RespondBufferReadLeft(BurstBuffer.ReadLeft());
       } break;
@@ -537,6 +1093,32 @@ void SerialExecute() { //on 1 in serial update, get values and execute commands
     case 5461586: {  //SVR, Set virtual position reset
         PositionVirtualSetStart(inkjetSmallValue);
       } break;
+    case 5461569: { //SVA, Set virtual acceleration
+        PositionSetVirtualAcceleration(inkjetSmallValue);
+      } break;
+    case 4675137: { //GVA, Get virtual acceleration
+        Ser.RespondVirtualAcceleration(PositionGetVirtualAcceleration());
+      } break;
+    case 5461572: { //SVD, Set virtual distance
+        PositionSetVirtualDistance(inkjetSmallValue);
+      } break;
+    case 4675140: { //GVD, Get virtual distance
+        Ser.RespondVirtualDistance(PositionGetVirtualDistance());
+      } break;
+    case 1397901136: { //SRGP, Set row gap
+        PositionSetRowGap(inkjetSmallValue);
+        EepromSaveRowGap();
+      } break;
+    case 1196574544: { //GRGP, Get row gap
+        Ser.RespondRowGap(PositionGetRowGap());
+      } break;
+    case 1380402000: { //RGCP, Row gap calibration pattern
+        PositionRowGapCalibrationPattern(inkjetSmallValue);
+      } break;
+    case 1380402003: { //RGCS, Row gap calibration select
+        PositionRowGapCalibrationSelect(inkjetSmallValue);
+        EepromSaveRowGap();
+      } break;
     case 1397771589: { //SPME, Set position mode to encoder
         PositionSetModeEncoder();
       } break;
@@ -606,6 +1188,204 @@ void SerialExecute() { //on 1 in serial update, get values and execute commands
     case 1196446544: { //GPSP:  Get pulse split
         Ser.RespondPulseSplit(dmaHP45.DMAGetPulseSplit());
       } break;
+    case 1397637965: { //SNCM, set nozzle compensation mode
+        if (inkjetSmallValue == 1 && nozzleStateTested == 1) { //only with a tested map, else all nozzles would be dead
+          nozzleDeadCount = dmaHP45.SetNozzleCompensation(NozzleState);
+          dmaHP45.SetNozzleCompensationEnabled(1);
+        }
+        else {
+          dmaHP45.SetNozzleCompensationEnabled(0);
+        }
+      } break;
+    case 1398034772: { //STQT, set quick test time
+        nozzleQuickTestInterval = constrain(inkjetSmallValue, 0, 3600000);
+      } break;
+    case 1196311373: { //GNCM, get nozzle compensation mode
+        int32_t temp_values[3] = {dmaHP45.GetNozzleCompensationEnabled(), nozzleDeadCount, dmaHP45.GetNozzleRemapCount()};
+        Ser.RespondValues("GNCM", 0, temp_values, 3);
+      } break;
+    case 1163084118: { //ESAV, EEPROM save
+        EepromSave();
+      } break;
+    case 1162628932: { //ELOD, EEPROM load
+        EepromLoad();
+      } break;
+    case 1347571012: { //PRMD, print mode
+        if (inkjetSmallValue == PRINT_SOURCE_FLASH || inkjetSmallValue == PRINT_SOURCE_SD) printSource = inkjetSmallValue;
+        else printSource = PRINT_SOURCE_SERIAL;
+        if (printSource != PRINT_SOURCE_FLASH) jobReadLine = -1; //stop adding lines from sources no longer in use
+        if (printSource != PRINT_SOURCE_SD) SdStop();
+      } break;
+    case 1246971212: { //JSEL, job select
+        if (inkjetSmallValue >= 0 && JobStore::GetJobLines(inkjetSmallValue) > 0) {
+          jobSelected = inkjetSmallValue;
+        }
+      } break;
+    case 1246905667: { //JREC, job record
+        if (inkjetSmallValue == 1) {
+          if (JobRecordAllowed() == 1) { //flash writes stop all interrupts, do not record while printing
+            bitWrite(warningList, WARNING_JOB_RECORD_ABORTED_BIT, 0);
+            JobStore::RecordStart();
+          }
+        }
+        else {
+          JobStore::RecordStop();
+        }
+      } break;
+    case 1246057043: { //JERS, job store erase
+        if (JobRecordAllowed() == 1) { //erasing stops all interrupts, do not erase while printing
+          jobReadLine = -1;
+          jobSelected = 0;
+          JobStore::Erase();
+        }
+      } break;
+    case 1196052290: { //GJOB, get job store state
+        if (inkjetSmallValue == 1) { //the number of lines of each job
+          int32_t temp_values[JOB_STORE_MAX_JOBS];
+          uint8_t temp_count = JobStore::GetJobCount();
+          for (uint8_t j = 0; j < temp_count; j++) {
+            temp_values[j] = JobStore::GetJobLines(j);
+          }
+          Ser.RespondValues("GJOB", 1, temp_values, temp_count);
+        }
+        else {
+          int32_t temp_values[8] = {JobStore::GetUsable(), JobStore::GetJobCount(), JobStore::GetLinesUsed(), JobStore::GetLinesFree(),
+                                    JobStore::GetRecording(), printSource, jobSelected, jobReadLine};
+          Ser.RespondValues("GJOB", 0, temp_values, 8);
+        }
+      } break;
+    case 1112755278: { //BSLN, buffer slot number
+        inkjetSmallValue = constrain(inkjetSmallValue, 1, BUFFER_SLOTS);
+        BurstBuffer.SetSlots(inkjetSmallValue);
+        serialBufferFirst[0] = 1; //set buffers to firstline
+        serialBufferFirst[1] = 1;
+      } break;
+    case 1112755283: { //BSLS, buffer slot select
+        if (inkjetSmallValue >= 0 && inkjetSmallValue < BurstBuffer.GetSlotCount()) {
+          BufferSelectSlot(inkjetSmallValue);
+        }
+      } break;
+    case 1195529036: { //GBSL, get buffer slots
+        int32_t temp_values[3 + BUFFER_SLOTS];
+        uint8_t temp_count = BurstBuffer.GetSlotCount();
+        temp_values[0] = temp_count;
+        temp_values[1] = BurstBuffer.GetSlot();
+        temp_values[2] = BurstBuffer.GetSlotSize();
+        for (uint8_t s = 0; s < temp_count; s++) {
+          temp_values[3 + s] = BurstBuffer.GetSlotLines(s);
+        }
+        Ser.RespondValues("GBSL", 0, temp_values, 3 + temp_count);
+      } break;
+    case 1397903440: { //SRPP, set repeat pitch
+        BurstBuffer.SetRepeat(inkjetSmallValue, BurstBuffer.GetRepeatCount());
+      } break;
+    case 1397903427: { //SRPC, set repeat count
+        inkjetSmallValue = max(inkjetSmallValue, 0);
+        BurstBuffer.SetRepeat(BurstBuffer.GetRepeatPitch(), inkjetSmallValue);
+      } break;
+    case 1196576851: { //GRPS, get repeat state
+        int32_t temp_values[4] = {BurstBuffer.GetRepeatPitch(), int32_t(BurstBuffer.GetRepeatCount()), int32_t(BurstBuffer.GetRepeatIndex(0)), int32_t(BurstBuffer.GetRepeatIndex(1))};
+        Ser.RespondValues("GRPS", 0, temp_values, 4);
+      } break;
+    case 1112753483: { //BSEK, buffer seek
+        int32_t temp_values[2];
+        BufferSeek(inkjetSmallValue, temp_values);
+        Ser.RespondValues("BSEK", 0, temp_values, 2);
+      } break;
+    case 1111706960: { //BCMP, buffer compression
+        BurstBuffer.SetCompression(inkjetSmallValue);
+        serialBufferFirst[0] = 1; //set buffers to firstline
+        serialBufferFirst[1] = 1;
+      } break;
+    case 1195524941: { //GBCM, get buffer compression
+        int32_t temp_values[4] = {BurstBuffer.GetCompression(), BurstBuffer.GetSlotSize(), BurstBuffer.GetPoolSize(), BurstBuffer.PoolLeft()};
+        Ser.RespondValues("GBCM", 0, temp_values, 4);
+      } break;
+    case 1396985680: { //SDOP, SD open job file
+        SdOpen(inkjetSmallValue);
+      } break;
+    case 1196639315: { //GSDS, get SD state
+        SdRespond();
+      } break;
+    case 1195659843: { //GDRC, get drop counters
+        DropCountRespond(inkjetSmallValue);
+      } break;
+    case 1380209219: { //RDRC, reset job drop counter
+        dropJobTotal = 0;
+      } break;
+    case 1396986435: { //SDRC, save drop counters
+        EepromSaveDropCounters();
+      } break;
+    case 1397968980: { //SSPT, set spit time
+        spitInterval = constrain(inkjetSmallValue, 0, 3600000);
+        spitLast = millis();
+        for (uint8_t a = 0; a < 22; a++) { //start with a clean slate
+          spitFired[a] = 0;
+          spitStale[a] = 0;
+        }
+      } break;
+    case 1397968962: { //SSPB, set spit budget
+        spitBudget = constrain(inkjetSmallValue, 0, 300);
+      } break;
+    case 1397968979: { //SSPS, set spit position
+        spitPosition = inkjetSmallValue;
+      } break;
+    case 1397968983: { //SSPW, set spit position window
+        spitPositionWindow = constrain(inkjetSmallValue, 0, 1000000);
+      } break;
+    case 1196642387: { //GSPS, get spit state
+        int32_t temp_stale = 0;
+        for (uint8_t a = 0; a < 22; a++) {
+          temp_stale += __builtin_popcount(spitStale[a]);
+        }
+        int32_t temp_values[4] = {int32_t(spitInterval), spitBudget, temp_stale, int32_t(spitCount)};
+        Ser.RespondValues("GSPS", 0, temp_values, 4);
+      } break;
+    case 1397573200: { //SMFP, set minimum fire period
+        inkjetMinFirePeriod = constrain(inkjetSmallValue, 0, 100000);
+      } break;
+    case 1397115981: { //SFLM, set fire limit mode
+        inkjetFireLimitMode = constrain(inkjetSmallValue, INKJET_FIRE_LIMIT_OFF, INKJET_FIRE_LIMIT_DROP);
+        uint32_t temp_old = micros() - 100001; //the times were not kept while the limit was off, start as if no nozzle fired within the longest period
+        for (uint8_t a = 0; a < 22; a++) {
+          for (uint8_t p = 0; p < 14; p++) {
+            inkjetNozzleLastFire[a][p] = temp_old;
+          }
+        }
+      } break;
+    case 1196249942: { //GMSV, get maximum safe velocity
+        int32_t temp_values[4] = {int32_t(InkjetGetMaxVelocity()), int32_t(inkjetMinFirePeriod), inkjetFireLimitMode, int32_t(inkjetOverspeedCount)};
+        Ser.RespondValues("GMSV", 0, temp_values, 4);
+      } break;
+    case 1397774147: { //SPWC, set pulse width compensation
+        dmaHP45.SetPulseWidthCompensation(inkjetSmallValue);
+      } break;
+    case 1397774164: { //SPWT, set pulse width table
+        dmaHP45.SetPulseWidthTable(inkjetSmallValue >> 16, inkjetSmallValue & 0xFFFF);
+      } break;
+    case 1196447556: { //GPWD, get pulse width data
+        int32_t temp_values[4] = {dmaHP45.GetPulseWidth(), dmaHP45.GetPulseWidthIndex(), dmaHP45.GetPulseWidthCompensation(), inkjetIdlePreheatTemperature};
+        Ser.RespondValues("GPWD", 0, temp_values, 4);
+      } break;
+    case 1397313608: { //SIPH, set idle preheat temperature
+        inkjetIdlePreheatTemperature = constrain(inkjetSmallValue, 0, HEAD_WARNING_TEMPERATURE);
+      } break;
+    case 1398034246: { //STOF, set trigger start offset
+        TriggerSetStartOffset(inkjetSmallValue);
+      } break;
+    case 4674641: { //GTQ, get trigger queue
+        Ser.RespondTriggerQueue(TriggerQueueGetCount());
+      } break;
+    case 4412497: { //CTQ, clear trigger queue
+        TriggerQueueClear();
+        bitWrite(warningList, WARNING_TRIGGER_QUEUE_FULL_BIT, 0);
+      } break;
+    case 1195529044: { //GBST, get burst statistics
+        BurstStatRespond(inkjetSmallValue);
+      } break;
+    case 1380078420: { //RBST, reset burst statistics
+        BurstStatReset();
+      } break;
     case 1196900690: { //GWAR, get warning
         Ser.RespondWarning(warningList); //respond with warning
       } break;
@@ -645,6 +1425,14 @@ void SerialExecute() { //on 1 in serial update, get values and execute commands
     case 591616323: { //#CYC set cycle counter state
         CycleCounterEnable(inkjetSmallValue);
       } break;
+#ifdef PROFILER_ENABLED
+    case 592466502: { //#PRF, profiler dump (binary)
+        Profiler::Dump(Serial);
+      } break;
+    case 592466514: { //#PRR, profiler reset
+        Profiler::Reset();
+      } break;
+#endif
     case 63: { //?, help
         Ser.PrintHelp();
       }
@@ -690,45 +1478,49 @@ void SerialWLPush() { //checks if requirements for a pushed WL response are met
 
 //Trigger functions
 void UpdateTrigger() { //looks at whether a trigger event happened and what needs to be done next
-  static uint32_t triggerUpdateHistory;
-  if (micros() - triggerUpdateHistory > TRIGGER_UPDATE_DELAY) { //limit the numer of updates
-    triggerUpdateHistory = micros(); //set the new time
-    //look if a trigger happened
-    uint8_t tempResponse = TriggerUpdate();
-    static uint8_t responseHistory;
-    if (tempResponse == 1) {
-      //what type of trigger happened (for now only "trigger")
-      Serial.println("Trigger");
-
-      //pass trigger to buffer
-      if (BurstBuffer.GetMode() == 1 || BurstBuffer.GetMode() == 2) { //only reset the buffer is the printing mode is static or looping
-        BufferReset(); //reset the buffer
-      }
-
-      //pass trigger to position
-      PositionVirtualTrigger();
+  //look if a trigger happened (trigger pins are debounced by time in Trigger, so this is checked every cycle)
+  uint8_t tempResponse = TriggerUpdate();
+  static uint8_t responseHistory;
+  if (tempResponse == 1 && TriggerGetStartOffset() != 0) { //with a start offset, the trigger waits in the queue until the product reaches the head
+    if (TriggerQueueAdd(TriggerGetEventPosition() + TriggerGetStartOffset()) == 0) { //if the queue is full, the trigger is lost
+      bitWrite(warningList, WARNING_TRIGGER_QUEUE_FULL_BIT, 1);
     }
-    if (responseHistory == 1 && tempResponse == 2) { //if the response goes from a trigger to a while trigger, set while active to 1
-      triggerWhileActive = 1;
-    }
-    if (responseHistory == 2 && tempResponse == 0) { //if history shows an active while trigger which became low, stop the trigger
-      PositionVirtualStop();
-      triggerWhileActive = 0;
-      //Serial.println("Trigger stop");
-    }
-    responseHistory = tempResponse; //write trigger history to variable
   }
+  else if (tempResponse == 1) {
+    //what type of trigger happened (for now only "trigger")
+    Serial.println("Trigger");
+
+    //pass trigger to buffer
+    BufferStartJob(TriggerGetSlotSelect());
+
+    //pass trigger to position, relative to the moment of the edge
+    PositionVirtualTriggerFrom(TriggerGetEventTime(), TriggerGetEventEncoder());
+  }
+  if (TriggerQueueReached(PositionGetBasePositionMicrons()) == 1) { //if the oldest pending trigger reached the head, start its job
+    BufferStartJob(TriggerQueueNextSlot());
+    int32_t temp_change = PositionVirtualTriggerAt(TriggerQueueNext()); //reset the position from the start position, not from where the head is now
+    TriggerQueueShift(temp_change); //the other pending triggers move along with the position
+  }
+  if (responseHistory == 1 && tempResponse == 2) { //if the response goes from a trigger to a while trigger, set while active to 1
+    triggerWhileActive = 1;
+  }
+  if (responseHistory == 2 && tempResponse == 0) { //if history shows an active while trigger which became low, stop the trigger
+    PositionVirtualStop();
+    triggerWhileActive = 0;
+    //Serial.println("Trigger stop");
+  }
+  responseHistory = tempResponse; //write trigger history to variable
 }
 
 //error functions
 void UpdateStatus() { //handles regular health checks and status led
-  if (burstOn == 0) { //only check when the printhead is not actively printing to prevent errors
+  if (dmaHP45.AdcGetSamples() > 0) { //the sense lines are sampled in the background (clear of bursts), so this also checks while printing
     if (millis() > checkTarget) { //check status
       checkTarget = millis() + checkDelay;
       errorState = 0; //reset error state
       int32_t temp_response;
       //check head logic voltage
-      temp_response = dmaHP45.GetVoltageLogic();
+      temp_response = dmaHP45.GetVoltageLogicFiltered();
       //Serial.println(temp_response);
       if (temp_response <  LOGIC_LOWER_VOLTAGE) {
         bitWrite(errorList, ERROR_LOGIC_VOLTAGE_LOW_BIT, 1);
@@ -744,7 +1536,7 @@ void UpdateStatus() { //handles regular health checks and status led
       }
 
       //check head driving voltage
-      temp_response = dmaHP45.GetVoltageHead();
+      temp_response = dmaHP45.GetVoltageHeadFiltered();
       //Serial.println(temp_response);
       if (temp_response <  DRIVING_LOWER_VOLTAGE) {
         bitWrite(errorList, ERROR_DRIVING_VOLTAGE_LOW_BIT, 1);
@@ -760,7 +1552,7 @@ void UpdateStatus() { //handles regular health checks and status led
       }
 
       //check head temperature
-      temp_response = dmaHP45.GetTemperature();
+      temp_response = dmaHP45.GetTemperatureFiltered();
       //Serial.println(temp_response);
       if (temp_response == -2) {
         bitWrite(errorList, ERROR_HEAD_TEMPERATURE_NC_BIT, 1);
@@ -769,7 +1561,7 @@ void UpdateStatus() { //handles regular health checks and status led
         bitWrite(errorList, ERROR_HEAD_TEMPERATURE_NC_BIT, 0);
       }
       if (temp_response >  HEAD_WARNING_TEMPERATURE) {
-        bitWrite(errorList, WARNING_HEAD_TEMPERATURE_HIGH_BIT, 1);
+        bitWrite(warningList, WARNING_HEAD_TEMPERATURE_HIGH_BIT, 1);
       }
       else {
         bitWrite(warningList, WARNING_HEAD_TEMPERATURE_HIGH_BIT, 0);
@@ -781,6 +1573,10 @@ void UpdateStatus() { //handles regular health checks and status led
         bitWrite(errorList, ERROR_HEAD_TEMPERATURE_HIGH_BIT, 0);
       }
 
+      //nozzle overspeed, stays set as long as nozzles were asked to fire too fast since the last check
+      bitWrite(warningList, WARNING_NOZZLE_OVERSPEED_BIT, inkjetOverspeed);
+      inkjetOverspeed = 0;
+
       if (warningList != 0) { //check for warnings
         errorState = 1;
       }
@@ -930,6 +1726,7 @@ void TestPrintheadFunctions(uint8_t tempReport) { //test all hardware functions
   }
 
   dmaHP45.TestHead(NozzleState, AddressState, PrimitiveState); //test nozzles second
+  nozzleStateTested = headPresent;
   if (tempReport == 1) { //if a full report is requested
     //report of working nozzles
     uint16_t workingNozzles = 0;
@@ -0,0 +1,47 @@
+/*
+  HeadSense
+  Converts the 13 bit readings of the printhead sense lines to a temperature and voltages in integer math. The functions only
+  do math, so they are kept apart from DMAPrint and can be tested on a computer (see test/HeadSenseTest.cpp).
+*/
+
+#ifndef HeadSense_h
+#define HeadSense_h
+
+#include <stdint.h>
+
+#define TEMPERATURE_SENSE_R1 3300 //the resistance of the temperature sense divider in .1 ohm
+#define TEMPERATURE_SENSE_MIN 1500 //the lowest reasonable resistance of the 10X and TSR in .1 ohm
+#define TEMPERATURE_SENSE_MAX 5000 //the highest reasonable resistance of the 10X and TSR in .1 ohm
+#define VOLTAGE_SENSE_R1 10000 //the resistance of the first resistor in all voltage sensing
+#define VOLTAGE_SENSE_R2 1200 //the resistance of the second resistor in all voltage sensing
+#define VOLTAGE_SENSE_FULL_SCALE ((3300 * (VOLTAGE_SENSE_R1 + VOLTAGE_SENSE_R2)) / VOLTAGE_SENSE_R2) //the voltage in millivolts at a full scale reading (30800)
+
+static inline int32_t HeadSenseTemperature(int32_t temp10x, int32_t tempTsr) { //calculates the temperature (in .1C) from 13 bit 10X and TSR readings, -2 if not reasonable
+  //Vout = (R2 / (R2 + R1)) * Vin, R1 is 330ohm
+  //R2 = ((Vout x R1)/(Vin-Vout)), Vin cancels out, so R2 = (raw x R1) / (8192 - raw)
+  //all resistances are in .1 ohm, so the whole calculation stays in integers
+  if (temp10x < 0 || temp10x >= 8192) return -2;
+  if (tempTsr < 0 || tempTsr >= 8192) return -2;
+  int32_t temp10xRes = (temp10x * TEMPERATURE_SENSE_R1) / (8192 - temp10x); //get the 10x resistance
+  int32_t tempTsrRes = (tempTsr * TEMPERATURE_SENSE_R1) / (8192 - tempTsr); //get the tsr resistance
+
+  //check both to be reasonable values
+  if (temp10xRes < TEMPERATURE_SENSE_MIN || temp10xRes > TEMPERATURE_SENSE_MAX) return -2;
+  if (tempTsrRes < TEMPERATURE_SENSE_MIN || tempTsrRes > TEMPERATURE_SENSE_MAX) return -2;
+
+  //get the TSR - 10X
+  //at 10 ohms, the temperature is 20C, for every 1.1 ohms the temperature rises 1 degree
+  //T = 1.1R+10, in .1C and with R in .1 ohm this becomes T = 11R/10 + 100
+  int32_t tempDelta = tempTsrRes - temp10xRes;
+  return (11 * tempDelta) / 10 + 100; //return celcius
+}
+
+static inline uint32_t HeadSenseVoltage(int32_t tempV) { //calculates the voltage in millivolts of a sense line from a 13 bit reading
+  //Vout = (R2 / (R2 + R1)) * Vin
+  //Vin = ((R2+R1) / R2) * Vout <this one is used
+  //the full scale voltage is precalculated, so only a multiply and shift remain
+  if (tempV <= 0) return 0;
+  return (uint32_t(tempV) * VOLTAGE_SENSE_FULL_SCALE) >> 13;
+}
+
+#endif
@@ -0,0 +1,178 @@
+/*
+  JobStore
+  Reads and writes jobs in flash. Reading is done straight from the memory mapped flash, writing goes through the flash
+  controller (FTFE on the Teensy 3.5 and 3.6), 8 bytes (a phrase) at a time.
+
+  Directory entry n is at JOB_STORE_START + 8n: first line (4 bytes), number of lines (4 bytes). An erased entry (all 1)
+  marks the end of the directory. Line n is at JOB_STORE_START + JOB_STORE_SECTOR + 48n: position (4 bytes), burst (44 bytes).
+*/
+
+#include "JobStore.h"
+
+extern "C" unsigned long _etext, _sdata, _edata; //end of the program in flash, and the initialised data that is copied after it
+
+uint8_t JobStore::usable = 0;
+uint8_t JobStore::jobCount = 0;
+uint8_t JobStore::recording = 0;
+uint32_t JobStore::recordFirst = 0;
+uint32_t JobStore::recordLines = 0;
+
+uint8_t JobStore::Begin(void) { //checks if the store is free of the program and reads the directory, returns 1 if the store is usable
+  usable = 0;
+  jobCount = 0;
+  recording = 0;
+  if (JOB_STORE_END <= JOB_STORE_START) return 0; //no store on this board
+  uint32_t tempProgramEnd = (uint32_t)&_etext + ((uint32_t)&_edata - (uint32_t)&_sdata);
+  if (tempProgramEnd > JOB_STORE_START) return 0; //the program grew into the store, never write there
+  usable = 1;
+  while (jobCount < JOB_STORE_MAX_JOBS && GetJobLines(jobCount) >= 0) { //count the directory entries
+    jobCount++;
+  }
+  return 1;
+}
+
+uint8_t JobStore::GetUsable(void) {
+  return usable;
+}
+
+uint8_t JobStore::Erase(void) { //erases all jobs, only sectors that hold data are erased. Returns 1 if successful
+  if (usable == 0) return 0;
+  recording = 0;
+  for (uint32_t a = JOB_STORE_START; a < JOB_STORE_END; a += JOB_STORE_SECTOR) {
+    if (IsErased(a, JOB_STORE_SECTOR) == 0) {
+      if (EraseSector(a) == 0) return 0;
+    }
+  }
+  jobCount = 0;
+  return 1;
+}
+
+int8_t JobStore::RecordStart(void) { //starts a new job after the last one, returns the job number, or -1 if not possible
+  if (usable == 0 || recording == 1 || jobCount >= JOB_STORE_MAX_JOBS) return -1;
+  recordFirst = GetLinesUsed();
+  while (recordFirst < JOB_STORE_LINES && IsErased(LineAddress(recordFirst), JOB_STORE_LINE_SIZE) == 0) { //skip lines of a recording that was never finished
+    recordFirst++;
+  }
+  recordLines = 0;
+  recording = 1;
+  return jobCount;
+}
+
+int32_t JobStore::RecordAdd(int32_t tempPosition, uint16_t tempBurst[22]) { //writes one line to the job being recorded, returns lines left, or -1 if it failed
+  if (recording == 0) return -1;
+  uint32_t tempLine = recordFirst + recordLines;
+  if (tempLine >= JOB_STORE_LINES) return -1; //store is full
+  uint32_t tempAddress = LineAddress(tempLine);
+  uint32_t tempWords[12];
+  tempWords[0] = (uint32_t)tempPosition;
+  for (uint8_t w = 0; w < 11; w++) { //pack the burst in words, in the same order as it is in memory
+    tempWords[w + 1] = uint32_t(tempBurst[w * 2]) | (uint32_t(tempBurst[w * 2 + 1]) << 16);
+  }
+  for (uint8_t p = 0; p < 6; p++) {
+    if (ProgramPhrase(tempAddress + p * 8, tempWords[p * 2], tempWords[p * 2 + 1]) == 0) return -1;
+  }
+  recordLines++;
+  return JOB_STORE_LINES - tempLine - 1;
+}
+
+int8_t JobStore::RecordStop(void) { //finishes the job being recorded by writing its directory entry, returns the job number, or -1 if no job was made
+  if (recording == 0) return -1;
+  recording = 0;
+  if (recordLines == 0) return -1; //nothing recorded, no entry is made
+  if (ProgramPhrase(JOB_STORE_START + jobCount * 8, recordFirst, recordLines) == 0) return -1;
+  jobCount++;
+  return jobCount - 1;
+}
+
+void JobStore::RecordAbort(void) { //stops recording without writing to flash, the lines written so far are skipped by the next recording
+  recording = 0;
+}
+
+uint8_t JobStore::GetRecording(void) {
+  return recording;
+}
+
+uint8_t JobStore::GetJobCount(void) {
+  return jobCount;
+}
+
+int32_t JobStore::GetJobLines(uint8_t tempJob) { //returns the number of lines in a job, or -1 if the job does not exist
+  if (usable == 0 || tempJob >= JOB_STORE_MAX_JOBS) return -1;
+  const uint32_t *tempEntry = (const uint32_t *)(JOB_STORE_START + tempJob * 8);
+  if (tempEntry[1] == 0xFFFFFFFF) return -1; //erased entry
+  return tempEntry[1];
+}
+
+uint8_t JobStore::GetLine(uint8_t tempJob, uint32_t tempLine, int32_t *tempPosition, uint16_t tempBurst[22]) { //copies a line of a job, returns 0 if the line does not exist
+  if (tempJob >= jobCount) return 0;
+  if (int32_t(tempLine) >= GetJobLines(tempJob)) return 0;
+  const uint8_t *tempData = (const uint8_t *)LineAddress(JobFirst(tempJob) + tempLine);
+  memcpy(tempPosition, tempData, 4);
+  memcpy(tempBurst, tempData + 4, 44);
+  return 1;
+}
+
+int32_t JobStore::GetLinesUsed(void) { //returns the first line after the last job
+  if (jobCount == 0) return 0;
+  return JobFirst(jobCount - 1) + GetJobLines(jobCount - 1);
+}
+
+int32_t JobStore::GetLinesFree(void) {
+  if (usable == 0) return 0;
+  return JOB_STORE_LINES - GetLinesUsed();
+}
+
+uint32_t JobStore::JobFirst(uint8_t tempJob) { //returns the first line of a job
+  return *(const uint32_t *)(JOB_STORE_START + tempJob * 8);
+}
+
+uint32_t JobStore::LineAddress(uint32_t tempLine) {
+  return JOB_STORE_START + JOB_STORE_SECTOR + tempLine * JOB_STORE_LINE_SIZE;
+}
+
+uint8_t JobStore::IsErased(uint32_t tempAddress, uint32_t tempLength) { //returns 1 if all bytes in the range are erased, the range is in whole words
+  const uint32_t *tempData = (const uint32_t *)tempAddress;
+  for (uint32_t w = 0; w < tempLength / 4; w++) {
+    if (tempData[w] != 0xFFFFFFFF) return 0;
+  }
+  return 1;
+}
+
+uint8_t JobStore::ProgramPhrase(uint32_t tempAddress, uint32_t tempWord0, uint32_t tempWord1) { //writes 8 bytes to an erased, 8 byte aligned address
+  while ((FTFL_FSTAT & FTFL_FSTAT_CCIF) == 0); //wait for any previous command
+  FTFL_FSTAT = FTFL_FSTAT_RDCOLERR | FTFL_FSTAT_ACCERR | FTFL_FSTAT_FPVIOL; //clear old errors, a new command is not accepted with them set
+  FTFL_FCCOB0 = 0x07; //program phrase
+  FTFL_FCCOB1 = tempAddress >> 16;
+  FTFL_FCCOB2 = tempAddress >> 8;
+  FTFL_FCCOB3 = tempAddress;
+  FTFL_FCCOB4 = tempWord0 >> 24; //the registers hold each word most significant byte first
+  FTFL_FCCOB5 = tempWord0 >> 16;
+  FTFL_FCCOB6 = tempWord0 >> 8;
+  FTFL_FCCOB7 = tempWord0;
+  FTFL_FCCOB8 = tempWord1 >> 24;
+  FTFL_FCCOB9 = tempWord1 >> 16;
+  FTFL_FCCOBA = tempWord1 >> 8;
+  FTFL_FCCOBB = tempWord1;
+  return FlashCommand();
+}
+
+uint8_t JobStore::EraseSector(uint32_t tempAddress) { //erases one sector
+  while ((FTFL_FSTAT & FTFL_FSTAT_CCIF) == 0); //wait for any previous command
+  FTFL_FSTAT = FTFL_FSTAT_RDCOLERR | FTFL_FSTAT_ACCERR | FTFL_FSTAT_FPVIOL; //clear old errors
+  FTFL_FCCOB0 = 0x09; //erase flash sector
+  FTFL_FCCOB1 = tempAddress >> 16;
+  FTFL_FCCOB2 = tempAddress >> 8;
+  FTFL_FCCOB3 = tempAddress;
+  return FlashCommand();
+}
+
+FASTRUN uint8_t JobStore::FlashCommand(void) { //runs the command set in the registers, returns 1 if successful
+  //this runs from RAM with interrupts off, the flash can not be read while it is busy
+  __disable_irq();
+  FTFL_FSTAT = FTFL_FSTAT_CCIF; //launch the command
+  while ((FTFL_FSTAT & FTFL_FSTAT_CCIF) == 0); //wait until done
+  FMC_PFB0CR |= 0x00F80000; //invalidate the flash cache and speculation buffer, so new data is read
+  __enable_irq();
+  if (FTFL_FSTAT & (FTFL_FSTAT_ACCERR | FTFL_FSTAT_FPVIOL | FTFL_FSTAT_MGSTAT0)) return 0;
+  return 1;
+}
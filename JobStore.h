@@ -0,0 +1,65 @@
+/*
+  JobStore
+  The job store keeps print jobs in the unused top half of the program flash, so a job only has to be uploaded once
+  and can then be printed on every trigger without a host.
+
+  Jobs are stored in burst format, one line is a position (4 bytes) and a burst (44 bytes), just like a line in the buffer.
+  The first sector holds the job directory, one 8 byte entry per job (first line and number of lines). Lines of a job are
+  written while the job is being recorded, the directory entry is written when recording stops. Flash can only be
+  written once after an erase, so jobs can only be added, and the whole store is erased at once.
+
+  The store is only available on the Teensy 3.5 and 3.6. Flash commands stop all interrupts while they run, so
+  jobs should not be recorded or erased while printing.
+*/
+
+#ifndef JobStore_h
+#define JobStore_h
+
+#include <Arduino.h>
+
+#if defined(__MK64FX512__)
+#define JOB_STORE_START 0x00040000 //the top 256kB of the 512kB flash
+#define JOB_STORE_END 0x00080000
+#elif defined(__MK66FX1M0__)
+#define JOB_STORE_START 0x00080000 //the top 512kB of the 1MB flash
+#define JOB_STORE_END 0x00100000
+#else
+#define JOB_STORE_START 0 //no job store on other boards
+#define JOB_STORE_END 0
+#endif
+#define JOB_STORE_SECTOR 4096 //the erase size of the flash
+#define JOB_STORE_MAX_JOBS 64
+#define JOB_STORE_LINE_SIZE 48 //position and burst
+#define JOB_STORE_LINES ((JOB_STORE_END - JOB_STORE_START - JOB_STORE_SECTOR) / JOB_STORE_LINE_SIZE)
+
+class JobStore {
+  public:
+    static uint8_t Begin(void);
+    static uint8_t GetUsable(void);
+    static uint8_t Erase(void);
+    static int8_t RecordStart(void);
+    static int32_t RecordAdd(int32_t tempPosition, uint16_t tempBurst[22]);
+    static int8_t RecordStop(void);
+    static void RecordAbort(void);
+    static uint8_t GetRecording(void);
+    static uint8_t GetJobCount(void);
+    static int32_t GetJobLines(uint8_t tempJob);
+    static uint8_t GetLine(uint8_t tempJob, uint32_t tempLine, int32_t *tempPosition, uint16_t tempBurst[22]);
+    static int32_t GetLinesUsed(void);
+    static int32_t GetLinesFree(void);
+
+  private:
+    static uint8_t usable;
+    static uint8_t jobCount;
+    static uint8_t recording;
+    static uint32_t recordFirst;
+    static uint32_t recordLines;
+    static uint32_t JobFirst(uint8_t tempJob);
+    static uint32_t LineAddress(uint32_t tempLine);
+    static uint8_t IsErased(uint32_t tempAddress, uint32_t tempLength);
+    static uint8_t ProgramPhrase(uint32_t tempAddress, uint32_t tempWord0, uint32_t tempWord1);
+    static uint8_t EraseSector(uint32_t tempAddress);
+    static uint8_t FlashCommand(void);
+};
+
+#endif
@@ -4,6 +4,10 @@
 
    Note that if virtual overflows all positions and velocities remain at their last value. While not ideal, it is worse than resetting all to 0
 
+   Virtual moves follow a trapezoidal profile. With an acceleration set, the velocity ramps up to the set velocity, and with a distance set,
+   the move ramps down in time to stop exactly on the end position. Both are integrated incrementally every update in integer math.
+   With an acceleration of 0 the velocity jumps straight to the set velocity, and with a distance of 0 the move runs until the max time.
+
    Todo:
    -Change test conditions to also include a timebase (of say 100us or 1ms) to make 0 a posible velocity.
    Right now the only recalculation is when there was a change, and this only happens with movement
@@ -28,8 +32,21 @@
 #include "Arduino.h"
 
 float encoderResolution = 600.0; //406.0; //the lines per inch (150) x4 for encoder type (quadrature) as a float
+uint32_t encoderMicronFactor = (25400.0 * 65536.0) / encoderResolution; //microns per encoder pulse in 16.16 fixed point, for fast integer conversions
 //Test encoder, 600 pulses per roatation, 150mm circ. wheel. 5.9055" per rotation. 2400/5.9055 = 406 pulses per inch.
-#define ROW_GAP 4050 //the distance in microns between odd and even row in long
+#define ROW_GAP 4050000 //the default distance in nanometers between odd and even row in long
+#define ROW_GAP_MIN 3000000 //the lowest row gap in nanometers that can be set
+#define ROW_GAP_MAX 5000000 //the highest row gap in nanometers that can be set
+#define POSITION_VIRTUAL_VELOCITY_MAX 100000 //the highest virtual velocity in millimeters per second, so it fits in microns per second
+int32_t positionRowGap = ROW_GAP; //the distance in nanometers between odd and even row, set per head
+#define ROW_GAP_HALF_FIXED ((int64_t(ROW_GAP) << 16) / 2000) //half the default row gap in 16.16 fixed point microns
+int64_t positionRowOffset[2] = {32768 - ROW_GAP_HALF_FIXED, ROW_GAP_HALF_FIXED + 32768}; //the offset of even (0) and odd (1) from the base position in 16.16 fixed point microns, including rounding
+
+#define ROW_GAP_CALIBRATION_PATCHES 21 //how many patches the row gap calibration pattern has, the middle one is the current row gap
+#define ROW_GAP_CALIBRATION_START 10000 //where the first calibration patch is printed in microns
+#define ROW_GAP_CALIBRATION_SPACING 2000 //the distance in microns between each calibration patch
+#define ROW_GAP_CALIBRATION_WIDTH 200 //the width in microns of each calibration line
+int32_t positionRowGapCalibrationStep = 5; //the row gap change in microns between 2 calibration patches
 
 //#define ENCODER_DO_NOT_USE_INTERRUPTS //interrupts risk firing while printhead is triggering, off for now
 #include "Encoder.h"
@@ -43,6 +60,7 @@ uint8_t positionEncoderPin[2] = {POSITION_ENCODER_PIN1, POSITION_ENCODER_PIN2};
 #define POSITION_STEP_TIMEOUT 100000 //how many microseconds no step has to be seen to set the velocity to 0
 
 Encoder positionEncoder(34, 33); //make an encoder instance
+int32_t positionEncoderOffset = 0; //added to the encoder count. Moving the position only changes the offset, writing the count could lose pulses
 uint8_t positionMode = 0; //what mode is active, 0 is encoder mode, 1 is virtual mode
 
 //encoder variables
@@ -68,6 +86,18 @@ int32_t positionVirtualStartPosition; //where the virtual has started
 int8_t positionVirtualDirection; //1 or -1, tells the direction of the printhead
 uint32_t positionVirtualMaxTime = 120000000; //maximum time in microseconds the virtual speed runs
 
+int32_t positionVirtualAcceleration = 0; //virtual acceleration and deceleration in mm/s^2, 0 jumps straight to the set velocity
+uint32_t positionVirtualMicronAcceleration = 0; //virtual acceleration in um/s^2
+int32_t positionVirtualDistance = 0; //how many microns a virtual move travels before stopping on the end position, 0 runs until the max time
+uint32_t positionVirtualCurrentMicronVelocity = 0; //the ramped (absolute) velocity in um/s the virtual position is moving at right now
+uint32_t positionVirtualTravelled; //how many microns the current virtual move has travelled
+uint32_t positionVirtualLastTime; //when the virtual profile was last integrated in microseconds
+uint32_t positionVirtualLiveTime; //the time the virtual base position belongs to, the live position continues from there
+uint32_t positionVirtualElapsedTime; //how long the current virtual move has been running in microseconds
+uint32_t positionVirtualVelocityRemainder; //what is left of the velocity integration after the last whole um/s (in um/s per 1000000)
+uint32_t positionVirtualPositionRemainder; //what is left of the position integration after the last whole micron (in microns per 1000000)
+#define POSITION_VIRTUAL_MIN_VELOCITY 1000 //the lowest velocity in um/s a ramp down crawls at, so the end position is always reached
+
 
 #define ENCODER_MODE 0
 #define VIRTUAL_MODE 1
@@ -75,21 +105,18 @@ uint32_t positionVirtualMaxTime = 120000000; //maximum time in microseconds the
 
 void PositionUpdate() {
   //calculate encoder position
-  positionEncoderRaw = positionEncoder.read();
+  positionEncoderRaw = PositionEncoderRead();
   if (positionEncoderHistory != positionEncoderRaw) { //if history and raw do not match, recalculate positions
     uint32_t temp_time = micros(); //write down time of change
 
-    //get micron position
-    float temp_calc = float(positionEncoderRaw);
-    temp_calc *= 25400.0; //by microns in an inch
-    temp_calc /= float(encoderResolution); //divide by lines per inch
-    positionBaseEncoderMicrons = long(temp_calc);
+    //get micron position in 16.16 fixed point
+    int64_t temp_fixed = int64_t(positionEncoderRaw) * encoderMicronFactor;
+    positionBaseEncoderMicrons = temp_fixed >> 16;
 
     //get odd and even micron position
-    temp_calc = float(ROW_GAP) / 2.0; //divide by 2 to give the offset from 0
-    temp_calc += float(positionBaseEncoderMicrons); //add to current position
-    positionRowEncoderMicrons[1] = long(temp_calc); //odd (1) is on the positive side, add row gap
-    positionRowEncoderMicrons[0] = positionRowEncoderMicrons[1] - ROW_GAP; //even (0) is on the negative side, subtract row gap
+    positionRowEncoderMicrons[1] = (temp_fixed + positionRowOffset[1]) >> 16; //odd (1) is on the positive side, add half the row gap
+    positionRowEncoderMicrons[0] = (temp_fixed + positionRowOffset[0]) >> 16; //even (0) is on the negative side, subtract half the row gap
+    float temp_calc;
 
     //calculate velocity (new pos - old pos)/ time it took is microns per microsecond
     positionEncoderVelocityUpdateCounter++; //add one encoder pulse to counter
@@ -125,38 +152,90 @@ void PositionUpdate() {
 
   //calculate virtual position
   if (positionVirtualEnabled == 1 && positionVirtualOverflow == 0) { //if virtual mode and no overflow
-    positionVirtualDirection = constrain(positionVirtualVelocity, -1, 1); //calculate direction
-
-    //calculate position based on start time and velocity
-    uint32_t temp_time_passed; //how much time has passed since start
-    uint32_t temp_current_time = micros(); //write millis to variable to prevent error if it overflows between check and calculation
-    //check for potential overflow conditions (micros timer overflows every 71 minutes)
-    if (positionVirtualStartTime > temp_current_time) { //if the millis() has overflown
-      //calculate time passed current time minus start
-      temp_time_passed = 4294967295 - positionVirtualStartTime; //get max time - start time for first component of the current time (the time until the overflow)
-      temp_time_passed += micros(); //add the time passed after the overflow
+    positionVirtualDirection = constrain(positionVirtualMicronVelocity, -1, 1); //calculate direction
+
+    //calculate how much time has passed since the last update (unsigned subtraction also holds when micros() overflows)
+    uint32_t temp_current_time = micros();
+    uint32_t temp_time_passed = temp_current_time - positionVirtualLastTime;
+    positionVirtualLastTime = temp_current_time;
+    positionVirtualElapsedTime += temp_time_passed;
+
+    //ramp the velocity towards the set velocity, or down towards the end position
+    uint32_t temp_target_velocity = abs(positionVirtualMicronVelocity);
+    if (positionVirtualMicronAcceleration == 0) { //no acceleration, jump to the set velocity
+      positionVirtualCurrentMicronVelocity = temp_target_velocity;
     }
-    else { //conventional time check
-      //calculate time passed current time minus start
-      temp_time_passed = temp_current_time - positionVirtualStartTime;
+    else {
+      uint64_t temp_calc = uint64_t(positionVirtualMicronAcceleration) * temp_time_passed; //velocity change in um/s per 1000000
+      temp_calc += positionVirtualVelocityRemainder;
+      uint32_t temp_velocity_step = temp_calc / 1000000; //whole um/s of velocity change
+      positionVirtualVelocityRemainder = temp_calc - uint64_t(temp_velocity_step) * 1000000; //keep the rest for the next update
+
+      uint8_t temp_braking = 0;
+      if (positionVirtualDistance > 0) { //check if the distance left is just enough to brake (v^2 >= 2*a*s)
+        uint32_t temp_distance_left = 0;
+        if (positionVirtualTravelled < uint32_t(positionVirtualDistance)) {
+          temp_distance_left = positionVirtualDistance - positionVirtualTravelled;
+        }
+        uint64_t temp_velocity_squared = uint64_t(positionVirtualCurrentMicronVelocity) * positionVirtualCurrentMicronVelocity;
+        if (temp_velocity_squared >= 2 * uint64_t(positionVirtualMicronAcceleration) * temp_distance_left) {
+          temp_braking = 1;
+        }
+      }
+
+      if (temp_braking == 1) { //ramp down, but never below the crawl velocity, the end position needs to be reached
+        if (positionVirtualCurrentMicronVelocity > temp_velocity_step + POSITION_VIRTUAL_MIN_VELOCITY) {
+          positionVirtualCurrentMicronVelocity -= temp_velocity_step;
+        }
+        else {
+          positionVirtualCurrentMicronVelocity = POSITION_VIRTUAL_MIN_VELOCITY;
+        }
+      }
+      else if (positionVirtualCurrentMicronVelocity < temp_target_velocity) { //ramp up
+        positionVirtualCurrentMicronVelocity += temp_velocity_step;
+        if (positionVirtualCurrentMicronVelocity > temp_target_velocity) positionVirtualCurrentMicronVelocity = temp_target_velocity;
+      }
+      else if (positionVirtualCurrentMicronVelocity > temp_target_velocity) { //ramp down to a lower set velocity
+        if (positionVirtualCurrentMicronVelocity > temp_target_velocity + temp_velocity_step) {
+          positionVirtualCurrentMicronVelocity -= temp_velocity_step;
+        }
+        else {
+          positionVirtualCurrentMicronVelocity = temp_target_velocity;
+        }
+      }
     }
 
     //calculate distance moved
-    float temp_fcalc = float(temp_time_passed); //take time
-    temp_fcalc /= 1000000.0; //convert to whole seconds
-    temp_fcalc *= float(positionVirtualMicronVelocity); //multiply by microns per second
+    uint64_t temp_calc = uint64_t(positionVirtualCurrentMicronVelocity) * temp_time_passed; //distance in microns per 1000000
+    temp_calc += positionVirtualPositionRemainder;
+    uint32_t temp_moved = temp_calc / 1000000; //whole microns moved
+    positionVirtualPositionRemainder = temp_calc - uint64_t(temp_moved) * 1000000; //keep the rest for the next update
+    positionVirtualTravelled += temp_moved;
+
+    //check if the end position is reached, stop on it exactly
+    if (positionVirtualDistance > 0 && positionVirtualTravelled >= uint32_t(positionVirtualDistance)) {
+      positionVirtualTravelled = positionVirtualDistance;
+      positionVirtualCurrentMicronVelocity = 0;
+      positionVirtualOverflow = 1;
+      //Serial.println("Position end reached");
+    }
 
-    positionBaseVirtualMicrons = long(temp_fcalc); //make new position
-    positionBaseVirtualMicrons += positionVirtualStartPosition; //add starting position
+    //make new position
+    int32_t temp_base = positionVirtualStartPosition;
+    if (positionVirtualDirection < 0) temp_base -= positionVirtualTravelled;
+    else temp_base += positionVirtualTravelled;
 
     //calculate row positions
-    int32_t temp_calc = ROW_GAP / 2;
-    positionRowVirtualMicrons[1] = positionBaseVirtualMicrons + temp_calc; //odd (1)is on positive side of the row gap
-    positionRowVirtualMicrons[0] = positionBaseVirtualMicrons - temp_calc; //even (0)is on negative side of the row gap
-
-
-    //check if the timer has overflown and virtual position has stopped
-    if (temp_time_passed > positionVirtualMaxTime) {
+    int64_t temp_fixed = int64_t(temp_base) << 16;
+    noInterrupts(); //the live position continues from the base position and its time, keep both from the same update
+    positionBaseVirtualMicrons = temp_base;
+    positionVirtualLiveTime = temp_current_time;
+    interrupts();
+    positionRowVirtualMicrons[1] = (temp_fixed + positionRowOffset[1]) >> 16; //odd (1)is on positive side of the row gap
+    positionRowVirtualMicrons[0] = (temp_fixed + positionRowOffset[0]) >> 16; //even (0)is on negative side of the row gap
+
+    //check if the timer has overflown and virtual position has stopped (only when no end position is given)
+    if (positionVirtualDistance == 0 && positionVirtualElapsedTime > positionVirtualMaxTime) {
       positionVirtualOverflow = 1;
       //Serial.println("Position overflow");
     }
@@ -171,6 +250,10 @@ void PositionSetModeVirtual() { //set position to virtual mode
   positionMode = VIRTUAL_MODE;
 }
 
+uint8_t PositionGetMode() { //returns the position mode, 0 is encoder mode, 1 is virtual mode
+  return positionMode;
+}
+
 //overal mode
 int32_t PositionGetBasePositionMicrons() { //returns the position of the base in microns
   if (positionMode == ENCODER_MODE) { //if the position is in encoder mode
@@ -199,7 +282,7 @@ int32_t PositionGetVelocity() { //returns the current velocity in millimeters pe
   }
   else if (positionMode == VIRTUAL_MODE) { //if position is in virtual mode
     if (positionVirtualOverflow == 0){
-      return positionVirtualVelocity;
+      return PositionGetVirtualCurrentVelocity();
     }
     else {
       return 0;
@@ -226,7 +309,11 @@ int32_t PositionGetBasepositionEncoderRaw() { //returns the position of the base
 
 void PositionSetBaseEncoderPositionMicrons(int32_t temp_position) { //sets the new encoder pulse position
   int32_t temp_raw = map(temp_position, 0, 25400, 0, long(encoderResolution)); //recalculate encoder position from microns to pulses
-  positionEncoder.write(temp_raw); //set new position
+  positionEncoderOffset = temp_raw - positionEncoder.read(); //set new position, pulses after the read still count from there
+}
+
+int32_t PositionEncoderRead() { //returns the encoder count with the position offset, safe to call from interrupts
+  return positionEncoder.read() + positionEncoderOffset;
 }
 
 int32_t PositionGetBaseEncoderPositionMicrons() {
@@ -239,6 +326,31 @@ int32_t PositionGetRowEncoderPositionMicrons(uint8_t temp_side) { //returns the
 }
 
 
+int32_t PositionGetBasePositionMicronsLive() { //returns the base position straight from the encoder in integer math, safe to call from interrupts
+  if (positionMode == VIRTUAL_MODE) {
+    return PositionGetVirtualMicronsLive();
+  }
+  int64_t temp_calc = int64_t(PositionEncoderRead()) * encoderMicronFactor; //pulses to microns in 16.16 fixed point
+  return temp_calc >> 16;
+}
+
+int32_t PositionGetRowPositionMicronsLive(uint8_t temp_side) { //returns the row position straight from the encoder in integer math, safe to call from interrupts
+  temp_side = constrain(temp_side, 0, 1);
+  if (positionMode == VIRTUAL_MODE) {
+    return ((int64_t(PositionGetVirtualMicronsLive()) << 16) + positionRowOffset[temp_side]) >> 16; //add the row offset of the side
+  }
+  int64_t temp_calc = int64_t(PositionEncoderRead()) * encoderMicronFactor; //pulses to microns in 16.16 fixed point
+  return (temp_calc + positionRowOffset[temp_side]) >> 16; //add the row offset of the side
+}
+
+int32_t PositionGetVirtualMicronsLive() { //returns the virtual base position moved on by the time since the last update, safe to call from interrupts
+  //PositionUpdate() writes the position and its time with interrupts off, so an interrupt always reads both from the same update
+  if (positionVirtualEnabled == 0 || positionVirtualOverflow == 1) return positionBaseVirtualMicrons; //not moving
+  uint32_t temp_moved = (uint64_t(positionVirtualCurrentMicronVelocity) * (micros() - positionVirtualLiveTime)) / 1000000; //microns moved since the update
+  if (positionVirtualDirection < 0) return positionBaseVirtualMicrons - temp_moved;
+  return positionBaseVirtualMicrons + temp_moved;
+}
+
 int32_t PositionGetEncoderVelocity() { //returns the current velocity in millimeters per second
   return positionEncoderVelocity;
 }
@@ -248,13 +360,78 @@ int8_t PositionGetEncoderDirection() { //returns the current direction
 }
 
 void PositionSetEncoderResolution(float temp_resolution) {
+  if (!(temp_resolution > 0.0)) return; //0, negative or not a number would break the conversion
   encoderResolution = temp_resolution;
+  encoderMicronFactor = (25400.0 * 65536.0) / encoderResolution; //update the integer conversion
 }
 
 float PositionGetEncoderResolution() {
   return encoderResolution;
 }
 
+//row gap
+void PositionSetRowGap(int32_t temp_gap) { //set the distance between odd and even row in nanometers
+  positionRowGap = constrain(temp_gap, ROW_GAP_MIN, ROW_GAP_MAX);
+  //precompute the row offsets once, so position updates only need an addition
+  int64_t temp_half = (int64_t(positionRowGap) << 16) / 2000; //half the row gap in 16.16 fixed point microns
+  positionRowOffset[1] = temp_half + 32768; //odd (1) is on the positive side (+0.5 for rounding)
+  positionRowOffset[0] = 32768 - temp_half; //even (0) is on the negative side (+0.5 for rounding)
+  positionEncoderHistory = positionEncoderRaw + 1; //force the encoder rows to be recalculated on the next update
+}
+
+int32_t PositionGetRowGap() { //returns the distance between odd and even row in nanometers
+  return positionRowGap;
+}
+
+void PositionRowGapCalibrationPattern(int32_t temp_step) { //fills the buffer with the row gap calibration pattern
+  /*
+     Each patch has a line printed by odd and a line printed by even. The even line is shifted by (patch - 10) steps,
+     so the middle patch shows the current row gap. Print the pattern, pick the patch where both lines overlap best
+     and select it with PositionRowGapCalibrationSelect().
+  */
+  if (temp_step <= 0) temp_step = 5; //default to 5 micron steps
+  positionRowGapCalibrationStep = constrain(temp_step, 1, 50);
+  uint16_t temp_burst[22];
+
+  BufferClear(); //the pattern replaces all data in the buffer
+  for (uint8_t a = 0; a < 22; a++) temp_burst[a] = 0;
+  BurstBuffer.Add(0, temp_burst); //start with all off
+
+  for (uint8_t p = 0; p < ROW_GAP_CALIBRATION_PATCHES; p++) {
+    int32_t temp_start[2], temp_end[2]; //where the line of each side starts and ends
+    temp_start[1] = ROW_GAP_CALIBRATION_START + int32_t(p) * ROW_GAP_CALIBRATION_SPACING; //odd (1) is the reference
+    temp_start[0] = temp_start[1] + (int32_t(p) - ROW_GAP_CALIBRATION_PATCHES / 2) * positionRowGapCalibrationStep; //even (0) is shifted
+    temp_end[0] = temp_start[0] + ROW_GAP_CALIBRATION_WIDTH;
+    temp_end[1] = temp_start[1] + ROW_GAP_CALIBRATION_WIDTH;
+
+    //sort the 4 edges of the patch, so the positions in the buffer keep going up
+    int32_t temp_edge[4] = {temp_start[0], temp_end[0], temp_start[1], temp_end[1]};
+    for (uint8_t i = 1; i < 4; i++) {
+      for (uint8_t j = i; j > 0 && temp_edge[j - 1] > temp_edge[j]; j--) {
+        int32_t temp_swap = temp_edge[j];
+        temp_edge[j] = temp_edge[j - 1];
+        temp_edge[j - 1] = temp_swap;
+      }
+    }
+
+    for (uint8_t e = 0; e < 4; e++) { //add a line on each edge with the sides that are printing from there on
+      if (e > 0 && temp_edge[e] == temp_edge[e - 1]) continue; //edges on the same position are a single line
+      uint16_t temp_overlay = 0;
+      //side 0 reads the odd overlay from the buffer, side 1 the even overlay
+      if (temp_edge[e] >= temp_start[0] && temp_edge[e] < temp_end[0]) temp_overlay |= PRIMITIVE_OVERLAY_ODD;
+      if (temp_edge[e] >= temp_start[1] && temp_edge[e] < temp_end[1]) temp_overlay |= PRIMITIVE_OVERLAY_EVEN;
+      for (uint8_t a = 0; a < 22; a++) temp_burst[a] = temp_overlay;
+      BurstBuffer.Add(temp_edge[e], temp_burst);
+    }
+  }
+}
+
+void PositionRowGapCalibrationSelect(int32_t temp_patch) { //applies the row gap of the patch (0-20) where odd and even overlapped best
+  temp_patch = constrain(temp_patch, 0, ROW_GAP_CALIBRATION_PATCHES - 1);
+  int32_t temp_change = (temp_patch - ROW_GAP_CALIBRATION_PATCHES / 2) * positionRowGapCalibrationStep; //in microns
+  PositionSetRowGap(positionRowGap + temp_change * 1000);
+}
+
 //virtual mode
 int32_t PositionGetVirtualVelocity() { //returns the current velocity in millimeters per second
   return positionVirtualVelocity;
@@ -264,13 +441,22 @@ int8_t PositionGetVirtualDirection() { //returns the current direction
   return positionVirtualDirection;
 }
 
+int32_t PositionGetVirtualCurrentVelocity() { //returns the ramped velocity in millimeters per second, never 0 while still moving
+  int32_t temp_velocity = positionVirtualCurrentMicronVelocity / 1000;
+  if (temp_velocity == 0 && positionVirtualCurrentMicronVelocity > 0) { //crawling below 1mm/s still counts as moving
+    temp_velocity = 1;
+  }
+  if (positionVirtualMicronVelocity < 0) temp_velocity = -temp_velocity;
+  return temp_velocity;
+}
+
 int32_t PositionGetVirtualPosition() { //returns the virtual position
   return positionBaseVirtualMicrons;
 }
 
 void PositionSetVirtualVelocity (int32_t temp_velocity) { //set the velocity in millimeters per second
   //set velocity in mm/s
-  positionVirtualVelocity = temp_velocity;
+  positionVirtualVelocity = constrain(temp_velocity, -POSITION_VIRTUAL_VELOCITY_MAX, POSITION_VIRTUAL_VELOCITY_MAX);
   positionVirtualMicronVelocity = positionVirtualVelocity * 1000;
   PositionResetVirtualBasevariables();
 }
@@ -282,6 +468,25 @@ void PositionSetVirtualVelocityMicrons (int32_t temp_velocity) { //set the veloc
   PositionResetVirtualBasevariables();
 }
 
+void PositionSetVirtualAcceleration (int32_t temp_acceleration) { //set the acceleration in millimeters per second squared, 0 for no ramps
+  temp_acceleration = constrain(temp_acceleration, 0, 100000);
+  positionVirtualAcceleration = temp_acceleration;
+  positionVirtualMicronAcceleration = positionVirtualAcceleration * 1000;
+}
+
+int32_t PositionGetVirtualAcceleration() { //returns the acceleration in millimeters per second squared
+  return positionVirtualAcceleration;
+}
+
+void PositionSetVirtualDistance (int32_t temp_distance) { //set the distance in microns a virtual move travels before stopping, 0 for no end position
+  if (temp_distance < 0) temp_distance = 0;
+  positionVirtualDistance = temp_distance;
+}
+
+int32_t PositionGetVirtualDistance() { //returns the distance in microns a virtual move travels
+  return positionVirtualDistance;
+}
+
 void PositionVirtualEnable(uint8_t temp_mode) { //enable or disable virtual mode
   //set the virtual mode to temp_mode
   temp_mode = constrain(temp_mode, 0, 1);
@@ -292,21 +497,71 @@ void PositionVirtualEnable(uint8_t temp_mode) { //enable or disable virtual mode
 void PositionResetVirtualBasevariables() { //internal function used to reset start time and position upon update
   positionVirtualStartTime = micros(); //set start time to current time
   positionVirtualStartPosition = positionBaseVirtualMicrons; //reset start to current position
+  positionVirtualLastTime = positionVirtualStartTime;
+  positionVirtualElapsedTime = 0;
+  positionVirtualTravelled = 0; //the distance now counts from the current position
+  positionVirtualPositionRemainder = 0;
+  if (constrain(positionVirtualMicronVelocity, -1, 1) != positionVirtualDirection) { //on a change of direction, ramp from standstill
+    positionVirtualCurrentMicronVelocity = 0;
+    positionVirtualVelocityRemainder = 0;
+  }
 }
 
 void PositionVirtualSetStart(int32_t temp_input) { //sets where virtual moves upon a reset
   positionVirtualResetPosition = temp_input;
 }
 
+int32_t PositionVirtualGetStart() { //returns where virtual moves upon a reset
+  return positionVirtualResetPosition;
+}
+
 void PositionVirtualTrigger() { //resets the position to reset position and restarts all variables
+  PositionVirtualTriggerFrom(micros(), PositionEncoderRead()); //trigger from right now
+}
+
+void PositionVirtualTriggerFrom(uint32_t temp_time, int32_t temp_encoder) { //resets the position as if it was done at the given time and encoder count
+  //the time and encoder count are captured on the trigger edge, so any movement since then is kept and the print starts relative to the edge
   if (positionMode == 1) { //if in virtual mode
     positionVirtualOverflow = 0; //reset any overflow
-    positionVirtualStartTime = micros(); //set start time to current time
+    positionVirtualStartTime = temp_time; //set start time to the time of the trigger, the next update integrates the time since
     positionVirtualStartPosition = positionVirtualResetPosition; //set start position
+    positionVirtualLastTime = positionVirtualStartTime;
+    positionVirtualElapsedTime = 0;
+    positionVirtualTravelled = 0;
+    positionVirtualPositionRemainder = 0;
+    positionVirtualVelocityRemainder = 0;
+    if (positionVirtualMicronAcceleration == 0) { //without ramps, start at the set velocity
+      positionVirtualCurrentMicronVelocity = abs(positionVirtualMicronVelocity);
+    }
+    else { //with ramps, start from standstill
+      positionVirtualCurrentMicronVelocity = 0;
+    }
+  }
+  else {
+    int32_t temp_reset_raw = map(positionVirtualResetPosition, 0, 25400, 0, long(encoderResolution)); //reset position in encoder pulses
+    positionEncoderOffset += temp_reset_raw - temp_encoder; //set new position, the pulses moved since the trigger are kept
+  }
+}
+
+int32_t PositionVirtualTriggerAt(int32_t temp_position) { //resets the position as if the trigger happened when the base passed the given position, returns the change in microns that was applied
+  //used for delayed triggers, the head is already a bit past the position, and this overshoot is kept
+  int32_t temp_change = positionVirtualResetPosition - temp_position; //how much all positions move by this reset
+  if (positionMode == 1) { //if in virtual mode
+    //the belt is still moving with the products behind this one, so only the position moves and the velocity carries on
+    positionBaseVirtualMicrons += temp_change; //keep the overshoot
+    positionRowVirtualMicrons[0] += temp_change;
+    positionRowVirtualMicrons[1] += temp_change;
+    positionVirtualStartPosition = positionBaseVirtualMicrons; //the distance and max time of the move count from the new job
+    positionVirtualTravelled = 0;
+    positionVirtualElapsedTime = 0;
+    positionVirtualOverflow = 0;
   }
   else {
-    PositionSetBaseEncoderPositionMicrons(positionVirtualResetPosition);
+    int32_t temp_change_raw = (int64_t(temp_change) << 16) / encoderMicronFactor; //change in encoder pulses
+    positionEncoderOffset += temp_change_raw; //set new position
+    temp_change = (int64_t(temp_change_raw) * encoderMicronFactor) >> 16; //the offset moves in whole pulses, return what it really moved so the queue moves the same
   }
+  return temp_change;
 }
 
 void PositionVirtualStop() { //stop the movement on the virtual position
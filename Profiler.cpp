@@ -0,0 +1,65 @@
+/*
+  Profiler
+  Stores the cycle counts of all measured stages. Add() is kept short, it is called from within the burst functions.
+
+  The binary dump is laid out as follows (all values little endian, as they are in memory):
+  "PRF" (3 bytes), number of stages (1 byte), number of bins (1 byte), cpu frequency in Hz (4 bytes)
+  then for each stage: count (4 bytes), minimum (4 bytes), maximum (4 bytes), total (8 bytes), histogram (4 bytes per bin)
+  The average is total divided by count. Histogram bin n holds all measurements from 2^n up to 2^(n+1) cycles.
+*/
+
+#include "Profiler.h"
+
+#ifdef PROFILER_ENABLED
+
+uint32_t Profiler::count[PROFILER_STAGES];
+uint32_t Profiler::minimum[PROFILER_STAGES];
+uint32_t Profiler::maximum[PROFILER_STAGES];
+uint64_t Profiler::total[PROFILER_STAGES];
+uint32_t Profiler::histogram[PROFILER_STAGES][PROFILER_BINS];
+
+void Profiler::Begin(void) { //starts the cycle counter and resets all values
+  ARM_DEMCR |= ARM_DEMCR_TRCENA; //enable the debug and trace unit
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA; //start the cycle counter
+  Reset();
+}
+
+void Profiler::Add(uint8_t tempStage, uint32_t tempCycles) { //adds one measurement to a stage
+  if (tempStage >= PROFILER_STAGES) return;
+  count[tempStage]++;
+  total[tempStage] += tempCycles;
+  if (tempCycles < minimum[tempStage]) minimum[tempStage] = tempCycles;
+  if (tempCycles > maximum[tempStage]) maximum[tempStage] = tempCycles;
+  uint8_t tempBin = 31 - __builtin_clz(tempCycles | 1); //log2 of the cycles
+  histogram[tempStage][tempBin]++;
+}
+
+void Profiler::Reset(void) { //clears all measurements
+  for (uint8_t s = 0; s < PROFILER_STAGES; s++) {
+    count[s] = 0;
+    minimum[s] = 0xFFFFFFFF;
+    maximum[s] = 0;
+    total[s] = 0;
+    for (uint8_t b = 0; b < PROFILER_BINS; b++) {
+      histogram[s][b] = 0;
+    }
+  }
+}
+
+void Profiler::Dump(Stream &tempPort) { //writes all measurements to the given port in binary
+  uint8_t tempHeader[5] = {'P', 'R', 'F', PROFILER_STAGES, PROFILER_BINS};
+  uint32_t tempFrequency = F_CPU;
+  tempPort.write(tempHeader, 5);
+  tempPort.write((uint8_t*)&tempFrequency, 4);
+  for (uint8_t s = 0; s < PROFILER_STAGES; s++) {
+    uint32_t tempMinimum = minimum[s];
+    if (count[s] == 0) tempMinimum = 0; //nothing measured yet
+    tempPort.write((uint8_t*)&count[s], 4);
+    tempPort.write((uint8_t*)&tempMinimum, 4);
+    tempPort.write((uint8_t*)&maximum[s], 4);
+    tempPort.write((uint8_t*)&total[s], 8);
+    tempPort.write((uint8_t*)histogram[s], 4 * PROFILER_BINS);
+  }
+}
+
+#endif
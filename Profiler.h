@@ -0,0 +1,57 @@
+/*
+  Profiler
+  The profiler measures how many processor cycles each stage of the program takes, using the DWT cycle counter.
+  Each stage keeps a minimum, maximum, total and a histogram with a bin per power of 2 cycles.
+  The results are dumped over serial in a binary form with #PRF, and reset with #PRR.
+
+  The profiler is only built in when PROFILER_ENABLED is defined. Without it, all PROFILER_START and PROFILER_STOP
+  calls compile to nothing, so the profiler costs no time when not in use.
+*/
+
+#ifndef Profiler_h
+#define Profiler_h
+
+#include <Arduino.h>
+
+//#define PROFILER_ENABLED //uncomment this line to build the profiler in
+
+//the stages that are measured
+#define PROFILER_POSITION_UPDATE 0
+#define PROFILER_BUFFER_UPDATE_VALUES 1
+#define PROFILER_INKJET_UPDATE_BURST_DELAY 2
+#define PROFILER_INKJET_UPDATE_BURST 3
+#define PROFILER_UPDATE_STATUS 4
+#define PROFILER_SERIAL_UPDATE 5
+#define PROFILER_SERIAL_EXECUTE 6
+#define PROFILER_UPDATE_TRIGGER 7
+#define PROFILER_SET_BURST 8
+#define PROFILER_BURST 9
+#define PROFILER_STAGES 10
+#define PROFILER_BINS 32 //one bin per power of 2 cycles
+
+#ifdef PROFILER_ENABLED
+#define PROFILER_START(stage) uint32_t profilerStart##stage = ARM_DWT_CYCCNT
+#define PROFILER_STOP(stage) Profiler::Add(stage, ARM_DWT_CYCCNT - profilerStart##stage)
+#else
+#define PROFILER_START(stage)
+#define PROFILER_STOP(stage)
+#endif
+
+#ifdef PROFILER_ENABLED
+class Profiler {
+  public:
+    static void Begin(void);
+    static void Add(uint8_t tempStage, uint32_t tempCycles);
+    static void Reset(void);
+    static void Dump(Stream &tempPort);
+
+  private:
+    static uint32_t count[PROFILER_STAGES];
+    static uint32_t minimum[PROFILER_STAGES];
+    static uint32_t maximum[PROFILER_STAGES];
+    static uint64_t total[PROFILER_STAGES];
+    static uint32_t histogram[PROFILER_STAGES][PROFILER_BINS];
+};
+#endif
+
+#endif
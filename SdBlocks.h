@@ -0,0 +1,102 @@
+/*
+  SdBlocks
+  The block and refill logic of the SD player: checks the job header and moves the lines of a job file through 2 read ahead
+  blocks into the buffer. Reading and adding lines go through functions that are passed in, so the logic does not depend on
+  the SD library or the buffer and can be run on a computer against a regular file (see test/SdPlayerTest.cpp).
+*/
+
+#ifndef SdBlocks_h
+#define SdBlocks_h
+
+#include <stdint.h>
+#include <string.h>
+
+#define SD_HEADER_SIZE 512
+#define SD_LINE_SIZE 48
+#define SD_BLOCK_LINES 32 //32 lines of 48 bytes are exactly 3 sectors, kept small because the buffer takes most of the memory
+#define SD_BLOCK_SIZE (SD_BLOCK_LINES * SD_LINE_SIZE)
+
+typedef int32_t (*SdReadFunction)(uint8_t *tempData, int32_t tempBytes); //reads the next bytes of the file, returns the bytes read
+typedef int32_t (*SdAddFunction)(const uint8_t *tempLines, int32_t tempCount); //adds packed lines to the buffer, returns the lines added
+
+struct SdBlocks {
+  uint8_t block[2][SD_BLOCK_SIZE]; //read ahead blocks
+  int32_t blockLines[2]; //the number of lines in each block, 0 is empty
+  int32_t blockUsed; //the number of lines of the active block that are in the buffer
+  uint8_t blockActive; //the block that is moved into the buffer
+  int32_t fileLines; //the number of lines in the file
+  int32_t linesRead; //how many lines were read from the file since the start of the job
+  int32_t linesAdded; //how many lines were moved to the buffer since the start of the job
+  uint8_t playing;
+};
+
+static inline int32_t SdBlocksHeaderLines(const uint8_t *tempHeader, int32_t tempFileSize) { //checks a job header, returns the lines that can be played, -1 if it is not a job
+  if (memcmp(tempHeader, "HP45", 4) != 0) return -1;
+  if ((tempHeader[4] | (tempHeader[5] << 8)) != 1 || (tempHeader[6] | (tempHeader[7] << 8)) != SD_LINE_SIZE) return -1;
+  int32_t tempLines;
+  memcpy(&tempLines, tempHeader + 8, 4);
+  int32_t tempLinesInFile = (tempFileSize - SD_HEADER_SIZE) / SD_LINE_SIZE; //never read past the end of a cut off file
+  if (tempLinesInFile < 0) tempLinesInFile = 0;
+  if (tempLines < 0) tempLines = 0;
+  if (tempLines > tempLinesInFile) tempLines = tempLinesInFile;
+  return tempLines;
+}
+
+static inline void SdBlocksStop(SdBlocks *tempPlayer) { //stops adding lines and empties the blocks
+  tempPlayer->playing = 0;
+  tempPlayer->blockLines[0] = 0;
+  tempPlayer->blockLines[1] = 0;
+}
+
+static inline void SdBlocksRead(SdBlocks *tempPlayer, uint8_t tempBlock, SdReadFunction tempRead) { //reads the next lines of the file in a block, at most one block per call
+  int32_t tempLines = tempPlayer->fileLines - tempPlayer->linesRead;
+  if (tempLines > SD_BLOCK_LINES) tempLines = SD_BLOCK_LINES;
+  if (tempLines <= 0) return;
+  int32_t tempBytes = tempRead(tempPlayer->block[tempBlock], tempLines * SD_LINE_SIZE);
+  if (tempBytes < SD_LINE_SIZE) { //read failed, end the file here
+    tempPlayer->fileLines = tempPlayer->linesRead;
+    return;
+  }
+  tempLines = tempBytes / SD_LINE_SIZE;
+  tempPlayer->blockLines[tempBlock] = tempLines;
+  tempPlayer->linesRead += tempLines;
+}
+
+static inline void SdBlocksStart(SdBlocks *tempPlayer, SdReadFunction tempRead) { //starts from the first line, the file needs to be at the first line
+  SdBlocksStop(tempPlayer);
+  tempPlayer->linesRead = 0;
+  tempPlayer->linesAdded = 0;
+  tempPlayer->blockActive = 0;
+  tempPlayer->blockUsed = 0;
+  if (tempPlayer->fileLines <= 0) return;
+  SdBlocksRead(tempPlayer, 0, tempRead); //fill both blocks, so the print can start from memory
+  SdBlocksRead(tempPlayer, 1, tempRead);
+  tempPlayer->playing = 1;
+}
+
+static inline void SdBlocksUpdate(SdBlocks *tempPlayer, SdAddFunction tempAdd, SdReadFunction tempRead, uint8_t tempReadAhead) { //moves lines from the active block to the buffer and reads the next block ahead if read ahead is 1
+  if (tempPlayer->playing == 0) return;
+  uint8_t tempActive = tempPlayer->blockActive;
+
+  if (tempPlayer->blockUsed < tempPlayer->blockLines[tempActive]) {
+    int32_t tempAdded = tempAdd(tempPlayer->block[tempActive] + tempPlayer->blockUsed * SD_LINE_SIZE, tempPlayer->blockLines[tempActive] - tempPlayer->blockUsed);
+    tempPlayer->blockUsed += tempAdded;
+    tempPlayer->linesAdded += tempAdded;
+  }
+  if (tempPlayer->blockUsed >= tempPlayer->blockLines[tempActive]) { //active block is in the buffer, switch to the other block
+    tempPlayer->blockLines[tempActive] = 0;
+    tempActive ^= 1;
+    tempPlayer->blockActive = tempActive;
+    tempPlayer->blockUsed = 0;
+    if (tempPlayer->blockLines[tempActive] == 0) SdBlocksRead(tempPlayer, tempActive, tempRead); //not read ahead, the buffer needs it now
+    if (tempPlayer->blockLines[tempActive] == 0) { //nothing left, the file is done
+      tempPlayer->playing = 0;
+      return;
+    }
+  }
+  if (tempReadAhead == 1 && tempPlayer->blockLines[tempActive ^ 1] == 0) { //read the next block while the active block is still being used
+    SdBlocksRead(tempPlayer, tempActive ^ 1, tempRead);
+  }
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+  The SD player prints jobs from the onboard SD card of the Teensy 3.5, for jobs that are longer than the buffer or
+  when serial can not keep up. On each trigger the buffer is cleared and filled from the file, ahead of the print.
+
+  Job files are named JOBnnn.HPJ (JOB000.HPJ to JOB999.HPJ) and are laid out as follows (all values little endian):
+  header (512 bytes): "HP45" (4 bytes), version (2 bytes, 1), line size (2 bytes, 48), number of lines (4 bytes), rest unused
+  lines (48 bytes each): position in microns (int32_t), then the burst (22 uint16_t, one per address, as in the buffer)
+
+  The header takes one sector so the lines start on a sector boundary. Lines are read in blocks of 32 lines (3 sectors).
+  There are 2 blocks, while one block is moved into the buffer, the other one is read ahead. The block logic is in SdBlocks.h,
+  apart from the card, so it can be tested and benchmarked on a computer against a regular file (see test/SdPlayerTest.cpp).
+
+  A card read blocks the main loop until it is done (about 1ms, sometimes several ms when the card is busy), so reading
+  ahead does not hide the card latency from the main loop, only from the buffer. In loop update mode the lines and bursts
+  are handled in the main loop, so while printing the next block is only read when the buffer runs low, and otherwise in
+  the gaps between print windows. In interrupt update mode the lines keep advancing during a read, but bursts still wait.
+*/
+
+#include <SD.h>
+#include "SdBlocks.h"
+
+uint8_t sdCardPresent = 0; //whether the card was found at startup
+uint8_t sdFileOpen = 0;
+File sdFile;
+SdBlocks sdPlayer; //the blocks and line counts of the job being played
+uint32_t sdReads = 0; //statistics of the card reads
+uint32_t sdReadTimeMax = 0;
+uint32_t sdReadTimeTotal = 0;
+uint32_t sdReadBytes = 0;
+
+void SdBegin() { //looks for the onboard card
+  sdCardPresent = SD.begin(BUILTIN_SDCARD);
+}
+
+uint8_t SdOpen(int32_t temp_job) { //opens job file n and checks the header, returns 1 if the file can be played
+  SdStop();
+  if (sdFileOpen == 1) {
+    sdFile.close();
+    sdFileOpen = 0;
+  }
+  sdPlayer.fileLines = 0;
+  if (sdCardPresent == 0 || temp_job < 0 || temp_job > 999) return 0;
+
+  char temp_name[12];
+  sprintf(temp_name, "JOB%03d.HPJ", int(temp_job));
+  sdFile = SD.open(temp_name, FILE_READ);
+  if (!sdFile) return 0;
+
+  uint8_t *temp_header = sdPlayer.block[0]; //the blocks are not in use while stopped
+  int32_t temp_lines = -1;
+  if (sdFile.read(temp_header, SD_HEADER_SIZE) == SD_HEADER_SIZE) temp_lines = SdBlocksHeaderLines(temp_header, sdFile.size());
+  if (temp_lines < 0) {
+    sdFile.close();
+    return 0;
+  }
+  sdPlayer.fileLines = temp_lines;
+  sdFileOpen = 1;
+  return 1;
+}
+
+void SdStart() { //clears the buffer and starts the open file from the first line
+  SdStop();
+  BufferClear();
+  if (sdFileOpen == 0 || sdPlayer.fileLines == 0) return;
+  sdFile.seek(SD_HEADER_SIZE);
+  sdReads = 0;
+  sdReadTimeMax = 0;
+  sdReadTimeTotal = 0;
+  sdReadBytes = 0;
+  SdBlocksStart(&sdPlayer, SdReadCard); //fill both blocks, so the print can start from memory
+}
+
+void SdStop() { //stops adding lines from the card
+  SdBlocksStop(&sdPlayer);
+}
+
+void SdUpdate() { //moves lines from the active block to the buffer and reads the next block ahead
+  if (sdPlayer.playing == 0) return;
+  uint8_t temp_read_ahead = 1;
+  if (burstOn == 1 && BurstBuffer.ReadLeft() > SD_BLOCK_LINES) temp_read_ahead = 0; //a read stalls the bursts, wait for a gap unless the buffer runs low
+  SdBlocksUpdate(&sdPlayer, SdAddToBuffer, SdReadCard, temp_read_ahead);
+}
+
+int32_t SdReadCard(uint8_t *temp_data, int32_t temp_bytes) { //reads the next bytes of the open file and keeps the read statistics
+  uint32_t temp_start = micros();
+  int32_t temp_read = sdFile.read(temp_data, temp_bytes);
+  uint32_t temp_time = micros() - temp_start;
+  sdReads++;
+  sdReadTimeTotal += temp_time;
+  if (temp_read > 0) sdReadBytes += temp_read;
+  if (temp_time > sdReadTimeMax) sdReadTimeMax = temp_time;
+  return temp_read;
+}
+
+int32_t SdAddToBuffer(const uint8_t *temp_lines, int32_t temp_count) { //adds packed lines to the buffer, out of reach of the buffer interrupt
+  uint8_t temp_lock = bufferUpdateLock;
+  bufferUpdateLock = 1;
+  int32_t temp_added = BurstBuffer.AddBulk(temp_lines, temp_count);
+  bufferUpdateLock = temp_lock;
+  return temp_added;
+}
+
+void SdRespond() { //responds with the state of the player and the card read statistics of the last job
+  int32_t temp_rate = 0; //kB per second while reading
+  if (sdReadTimeTotal > 0) temp_rate = (uint64_t(sdReadBytes) * 1000000) / (uint64_t(sdReadTimeTotal) * 1024);
+  int32_t temp_values[9] = {sdCardPresent, sdFileOpen, sdPlayer.fileLines, sdPlayer.playing, sdPlayer.linesRead, sdPlayer.linesAdded,
+                            int32_t(sdReads), int32_t(sdReadTimeMax), temp_rate};
+  Ser.RespondValues("GSDS", 0, temp_values, 9);
+}
@@ -21,6 +21,11 @@
   The list of commands is as follows:
   //direct inkjet commands
   -SBR:  Send inkjet to buffer raw
+  -SBN:  Send inkjet to buffer next (raster line)
+  -SRST: Set raster start
+  -SLPI: Set raster LPI
+  -SRDR: Set raster direction
+  -GRST: Get raster state
   -SBT:  Send inkjet to buffer toggle format <------------- to do
   -SAR:  Send inkjet to print ASAP raw
   -SAT:  Send inkjet to print ASAP toggle format <------------- to do
@@ -34,6 +39,21 @@
   //inkjet support functions
   -PHT:  Preheat printhead
   -PRM:  Prime printhead
+  -GPTS: Get pulse train state
+  -SSPT: Set spit time
+  -SSPB: Set spit budget
+  -SSPS: Set spit position
+  -SSPW: Set spit position window
+  -GSPS: Get spit state
+  -SNCM: Set nozzle compensation mode
+  -GNCM: Get nozzle compensation mode
+  -STQT: Set quick test time
+  -ESAV: EEPROM save
+  -ELOD: EEPROM load
+  -GDRC: Get drop counters
+  -RDRC: Reset job drop counter
+  -SDRC: Save drop counters
+  -PTST: Pulse train stop
   -THD:  Test printhead (small value 1 returns n of 300 nozzles)
   -GTP:  Get temperature
   -SDP:  Set DPI
@@ -42,8 +62,30 @@
   -SSID: Set side
   -SPSP: Set pulse splits
   -GPSP: Get pulse splits
-
-  -PRMD: Print mode (serial, eeprom, text) <------------ to do
+  -SPWC: Set pulse width compensation
+  -SPWT: Set pulse width table
+  -GPWD: Get pulse width data
+  -SIPH: Set idle preheat temperature
+  -SMFP: Set minimum fire period
+  -SFLM: Set fire limit mode
+  -GMSV: Get maximum safe velocity
+
+  -PRMD: Print mode (serial, flash, SD)
+  -JSEL: Job select
+  -JREC: Job record
+  -JERS: Job store erase
+  -GJOB: Get job store state
+  -SDOP: SD open job file
+  -BSLN: Buffer slot number
+  -BSLS: Buffer slot select
+  -GBSL: Get buffer slots
+  -SRPP: Set repeat pitch
+  -SRPC: Set repeat count
+  -GRPS: Get repeat state
+  -BSEK: Buffer seek
+  -BCMP: Buffer compression
+  -GBCM: Get buffer compression
+  -GSDS: Get SD state
 
   //position commands
   -SPME: Set position mode to encoder
@@ -53,25 +95,33 @@
   -GEP: Get encoder position
   -SER: Set encoder Resolution
   -GER: Get encoder Resolution
+  -SRGP: Set row gap
+  -GRGP: Get row gap
+  -RGCP: Row gap calibration pattern
+  -RGCS: Row gap calibration select
 
   -VENA: Virtual enable 
   -GVP: Get virtual position 
   -SVV: Set virtual velocity 
   -GVV: Get virtual velocity 
   -SVR: Set virtual position reset 
+  -SVA: Set virtual acceleration 
+  -GVA: Get virtual acceleration 
+  -SVD: Set virtual distance 
+  -GVD: Get virtual distance 
 
   //triggers
   -VTRI: Virtual Trigger 
   -VSTO: Virtual stop 
-  -STM0: Set trigger mode trigger 0 (0 off, 1 rising, 2 falling, 3 toggle)
-  -STM1: Set trigger mode trigger 1 (0 off, 1 rising, 2 falling, 3 toggle)
-  -STM2: Set trigger mode trigger 2 (0 off, 1 rising, 2 falling, 3 toggle)
-  -STM3: Set trigger mode trigger 3 (0 off, 1 rising, 2 falling, 3 toggle)
-  -STM4: Set trigger mode trigger 4 (0 off, 1 rising, 2 falling, 3 toggle)
-  -STM5: Set trigger mode trigger 5 (0 off, 1 rising, 2 falling, 3 toggle)
-  -STM6: Set trigger mode trigger 6 (0 off, 1 rising, 2 falling, 3 toggle)
-  -STM7: Set trigger mode trigger 7 (0 off, 1 rising, 2 falling, 3 toggle)
-  -STM8: Set trigger mode trigger 8 (0 off, 1 rising, 2 falling, 3 toggle)
+  -STM0: Set trigger mode trigger 0 (0 off, 1 rising, 2 falling, 3 toggle, 4 while high, 5 while low, 6 slot bit)
+  -STM1: Set trigger mode trigger 1 (0 off, 1 rising, 2 falling, 3 toggle, 4 while high, 5 while low, 6 slot bit)
+  -STM2: Set trigger mode trigger 2 (0 off, 1 rising, 2 falling, 3 toggle, 4 while high, 5 while low, 6 slot bit)
+  -STM3: Set trigger mode trigger 3 (0 off, 1 rising, 2 falling, 3 toggle, 4 while high, 5 while low, 6 slot bit)
+  -STM4: Set trigger mode trigger 4 (0 off, 1 rising, 2 falling, 3 toggle, 4 while high, 5 while low, 6 slot bit)
+  -STM5: Set trigger mode trigger 5 (0 off, 1 rising, 2 falling, 3 toggle, 4 while high, 5 while low, 6 slot bit)
+  -STM6: Set trigger mode trigger 6 (0 off, 1 rising, 2 falling, 3 toggle, 4 while high, 5 while low, 6 slot bit)
+  -STM7: Set trigger mode trigger 7 (0 off, 1 rising, 2 falling, 3 toggle, 4 while high, 5 while low, 6 slot bit)
+  -STM8: Set trigger mode trigger 8 (0 off, 1 rising, 2 falling, 3 toggle, 4 while high, 5 while low, 6 slot bit)
   -STR0: Set trigger resistor 0 (0 floating, 2 pulldown, 3 pullup)
   -STR1: Set trigger resistor 1 (0 floating, 2 pulldown, 3 pullup)
   -STR2: Set trigger resistor 2 (0 floating, 2 pulldown, 3 pullup)
@@ -82,6 +132,9 @@
   -STR7: Set trigger resistor 7 (0 floating, 2 pulldown, 3 pullup)
   -STR8: Set trigger resistor 8 (0 floating, 2 pulldown, 3 pullup)
   -STPU: Set trigger push <----------- to do
+  -STOF: Set trigger start offset
+  -GTQ:  Get trigger queue, number of pending triggers
+  -CTQ:  Clear trigger queue
 
   //buffer commands
   -BMOD: Buffer mode: 0 for clearing, 1 for static, 2 for looping
@@ -90,10 +143,13 @@
   -BWL:  Buffer get write left
   -BCL:  Buffer clear, remove all data from the buffer
   -BRES: Buffer reset, set to position 0
+  -BUPM: Buffer update mode: 0 for main loop, 1 for timer interrupt
 
   //status calls
   -GWAR: Get warnings. All non critical issues
   -GERR: Get error. All critical issues
+  -GBST: Get burst statistics (0 totals, 1 late histogram, 2 overshoot histogram)
+  -RBST: Reset burst statistics
   
   //direct control commands
   -SEN:  Software enable printhead
@@ -117,6 +173,8 @@
   -#GOK: Get ok state (of external serial)
   -#ROK: Reset the ok state (of external serial)
   -#CYC: set cycle counter state (A or B)
+  -#PRF: Profiler dump, binary (only when built with PROFILER_ENABLED)
+  -#PRR: Profiler reset (only when built with PROFILER_ENABLED)
   -!WPR: Write pin raw
   -!INM: Inkjet Mode
 
@@ -812,36 +870,85 @@ class SerialCommand {
         "\n"
         "List of commands:\n"
         "SBR: Send inkjet to buffer raw (needs small for pos and raw for inkjet data)\n"
+        "SBN: Send buffer next, a raster line at the next raster position (needs raw for the burst, small for n times, may be left empty for 1)\n"
+        "SRST: Set raster start, also restarts the raster line count (needs small for n position in microns)\n"
+        "SLPI: Set raster LPI, the distance between raster lines (needs small for n lines per inch)\n"
+        "SRDR: Set raster direction (needs small, 1 for up, -1 for down)\n"
+        "GRST: Get raster state, start, LPI, direction, line and next position (no extra input)\n"
         "SBT: Send inkjet to buffer toggle format (needs small for pos and raw for inkjet data)\n"
         "\n"
         "PHT: Preheat printhead (needs small for n pulses)\n"
         "PRM: Prime printhead (needs small for n pulses)\n"
+        "GPTS: Get pulse train state, running and pulses left (no extra input)\n"
+        "PTST: Pulse train stop, ends preheating or priming (no extra input)\n"
+        "SSPT: Set spit time, nozzles unused for this long are spit clear of the job or at the spit position (needs small for n time in ms, 0 for off)\n"
+        "SSPB: Set spit budget (needs small for the most nozzles spit per spit time)\n"
+        "SSPS: Set spit position, where spitting is allowed even within the job (needs small for n position in microns)\n"
+        "SSPW: Set spit position window, how far the head may be from the spit position (needs small for n distance in microns, 0 for off)\n"
+        "GSPS: Get spit state, spit time, budget, nozzles waiting and nozzles spit (no extra input)\n"
+        "SNCM: Set nozzle compensation mode, moves drops of dead nozzles to a neighbour (1 uses the last THD result, 0 for off)\n"
+        "GNCM: Get nozzle compensation mode, state, dead nozzles and moved nozzles (no extra input)\n"
+        "STQT: Set quick test time, one address is tested each time while not printing (needs small for n time in ms, 0 for off)\n"
+        "ESAV: EEPROM save, stores all settings so they are loaded at startup (no extra input)\n"
+        "ELOD: EEPROM load, reloads all saved settings (no extra input)\n"
+        "PRMD: Print mode, where lines come from (needs small, 0 for serial, 1 for the selected job in flash, 2 for the open SD job file, on each trigger)\n"
+        "JSEL: Job select, the job printed in flash print mode (needs small for the job number)\n"
+        "JREC: Job record, SBR lines are stored in flash as a new job instead of in the buffer (needs small, 1 to start, 0 to finish). A print or trigger while recording drops the job and sets warning bit 3\n"
+        "JERS: Job store erase, removes all jobs from flash (no extra input)\n"
+        "GJOB: Get job store state (0 for usable, jobs, lines used, lines free, recording, print mode, job and line, 1 for the lines of each job)\n"
+        "BSLN: Buffer slot number, splits the buffer in equal slots with their own image and mode, clears all (needs small for n slots, 1-8)\n"
+        "BSLS: Buffer slot select, reads and writes go to this slot (needs small for the slot number)\n"
+        "GBSL: Get buffer slots, number, selected, lines per slot and lines written to each slot (no extra input)\n"
+        "SRPP: Set repeat pitch, in looping mode the pattern repeats every n microns without a trigger (needs small for n microns, negative for down, 0 for off)\n"
+        "SRPC: Set repeat count, how many times the pattern is printed (needs small for n times, 0 for endless)\n"
+        "GRPS: Get repeat state, pitch, count and the repeat each side is on (no extra input)\n"
+        "BSEK: Buffer seek, resume a static or looping job at a position, responds with the line of each side, -1 if not possible (needs small for n position in microns)\n"
+        "BCMP: Buffer compression, repeated lines share one burst so 4 times the lines fit, clears all (needs small, 1 for on, 0 for off)\n"
+        "GBCM: Get buffer compression, state, lines per slot, bursts per slot and bursts free (no extra input)\n"
+        "SDOP: SD open job file JOBnnn.HPJ (needs small for the job number)\n"
+        "GSDS: Get SD state, card, file open, lines, playing, lines read, lines buffered, reads, slowest read us and kB/s (no extra input)\n"
+        "GDRC: Get drop counters (0 for job drops, job nl, lifetime ul and lifetime kilodrops, 1-6 for 50 nozzles each)\n"
+        "RDRC: Reset job drop counter (no extra input)\n"
+        "SDRC: Save drop counters to EEPROM (no extra input)\n"
         "THD: Test printhead (no extra input)\n"
         "GTP: Get temperature (no extra input)\n"
+        "SPWC: Set pulse width compensation by temperature and voltage (needs small for state (1 or 0))\n"
+        "SPWT: Set pulse width table (needs small for table position * 65536 + n width in nanoseconds)\n"
+        "GPWD: Get pulse width data, width in ns, table position, compensation and idle preheat temperature (no extra input)\n"
+        "SIPH: Set idle preheat temperature (needs small for n temperature in .1C, 0 for off)\n"
+        "SMFP: Set minimum fire period, the shortest time between two drops of a nozzle (needs small for n time in microseconds)\n"
+        "SFLM: Set fire limit mode (0 off, 1 warning only, 2 drop dots that come too fast)\n"
+        "GMSV: Get maximum safe velocity in mm/s, minimum fire period, fire limit mode and overspeed count (no extra input)\n"
         "\n"
         "SPME: Set position mode to encoder (no extra input)\n"
         "SPMV: Set position mode to virtual (no extra input)\n"
         "\n"
         "SEP: Set encoder position (needs small for n position in microns)\n"
         "GEP: Get encoder position (no extra input)\n"
+        "SRGP: Set row gap (needs small for n gap in nanometers, only the row gap is saved to EEPROM)\n"
+        "GRGP: Get row gap (no extra input)\n"
+        "RGCP: Row gap calibration pattern, fills the buffer (needs small for n step in microns)\n"
+        "RGCS: Row gap calibration select (needs small for the best patch, 0-20, only the row gap is saved to EEPROM)\n"
         "SDP: Set DPI (needs small for n DPI)\n"
-        "SDN: Set density (needs small for n percentage)\n"
+        "SDN: Set density (needs small for n percentage, 1-1000)\n"
         "SSID: Set printhead side. (0 for both, 1 for odd, 2 for even)\n"
         "\n"
         "VENA: Virtual enable (needs small for state (1 or 0))\n"
         "SVV: Set virtual velocity (needs small for n velocity in mm/s)\n"
         "SVR: Set virtual position reset (needs small for n position in microns)\n"
+        "SVA: Set virtual acceleration (needs small for n acceleration in mm/s^2, 0 for none)\n"
+        "SVD: Set virtual distance (needs small for n distance in microns, 0 for none)\n"
         "VTRI: Virtual Trigger (no extra input)\n"
         "VSTO: Virtual stop (no extra input)\n"
-        "STM0: Set trigger mode trigger 0 (0 off, 1 rising, 2 falling, 3 toggle)\n"
-        "STM1: Set trigger mode trigger 1 (0 off, 1 rising, 2 falling, 3 toggle)\n"
-        "STM2: Set trigger mode trigger 2 (0 off, 1 rising, 2 falling, 3 toggle)\n"
-        "STM3: Set trigger mode trigger 3 (0 off, 1 rising, 2 falling, 3 toggle)\n"
-        "STM4: Set trigger mode trigger 4 (0 off, 1 rising, 2 falling, 3 toggle)\n"
-        "STM5: Set trigger mode trigger 5 (0 off, 1 rising, 2 falling, 3 toggle)\n"
-        "STM6: Set trigger mode trigger 6 (0 off, 1 rising, 2 falling, 3 toggle)\n"
-        "STM7: Set trigger mode trigger 7 (0 off, 1 rising, 2 falling, 3 toggle)\n"
-        "STM8: Set trigger mode trigger 8 (0 off, 1 rising, 2 falling, 3 toggle)\n"
+        "STM0: Set trigger mode trigger 0 (0 off, 1 rising, 2 falling, 3 toggle, 4 while high, 5 while low, 6 slot bit)\n"
+        "STM1: Set trigger mode trigger 1 (0 off, 1 rising, 2 falling, 3 toggle, 4 while high, 5 while low, 6 slot bit)\n"
+        "STM2: Set trigger mode trigger 2 (0 off, 1 rising, 2 falling, 3 toggle, 4 while high, 5 while low, 6 slot bit)\n"
+        "STM3: Set trigger mode trigger 3 (0 off, 1 rising, 2 falling, 3 toggle, 4 while high, 5 while low, 6 slot bit)\n"
+        "STM4: Set trigger mode trigger 4 (0 off, 1 rising, 2 falling, 3 toggle, 4 while high, 5 while low, 6 slot bit)\n"
+        "STM5: Set trigger mode trigger 5 (0 off, 1 rising, 2 falling, 3 toggle, 4 while high, 5 while low, 6 slot bit)\n"
+        "STM6: Set trigger mode trigger 6 (0 off, 1 rising, 2 falling, 3 toggle, 4 while high, 5 while low, 6 slot bit)\n"
+        "STM7: Set trigger mode trigger 7 (0 off, 1 rising, 2 falling, 3 toggle, 4 while high, 5 while low, 6 slot bit)\n"
+        "STM8: Set trigger mode trigger 8 (0 off, 1 rising, 2 falling, 3 toggle, 4 while high, 5 while low, 6 slot bit)\n"
         "STR0: Set trigger resistor 0 (0 floating, 2 pulldown, 3 pullup)\n"
         "STR1: Set trigger resistor 1 (0 floating, 2 pulldown, 3 pullup)\n"
         "STR2: Set trigger resistor 2 (0 floating, 2 pulldown, 3 pullup)\n"
@@ -853,12 +960,18 @@ class SerialCommand {
         "STR8: Set trigger resistor 8 (0 floating, 2 pulldown, 3 pullup)\n"
 
         "STPU: Set trigger push notification (needs small for state (1 or 0))\n"
+        "STOF: Set trigger start offset (needs small for n distance in microns, 0 starts right away)\n"
+        "GTQ: Get trigger queue, number of pending triggers (no extra input)\n"
+        "CTQ: Clear trigger queue (no extra input)\n"
         "\n"
         "BRL: Buffer get read left (no extra input)\n"
         "BRLS: Buffer get read left per side (0 or 1 for side)\n"
         "BWL: Buffer get write left (no extra input)\n"
         "BCL: Buffer clear, remove all data (no extra input)\n"
         "BRES: Buffer reset, only reset read position (no extra input)\n"
+        "BUPM: Buffer update mode (0 for main loop, 1 for timer interrupt)\n"
+        "GBST: Get burst statistics (0 for totals, 1 for late histogram, 2 for overshoot histogram)\n"
+        "RBST: Reset burst statistics (no extra input)\n"
         "\n"
         "#COM: Command echo (needs small for state (1 or 0))\n"
         "#NDS: Numberdecode small (needs small to decode)\n"
@@ -972,6 +1085,67 @@ class SerialCommand {
       WriteValueToB64(tempVelocity); //convert 1B array to 64 bit
       SendResponse(); //send left
     }
+    void RespondVirtualAcceleration(int32_t tempAcceleration){
+      writeCharacters = 4; //set characters to value after adding response header
+      writeBuffer[0] = 'G';
+      writeBuffer[1] = 'V';
+      writeBuffer[2] = 'A';
+      writeBuffer[3] = ':';
+      WriteValueToB64(tempAcceleration); //convert 1B array to 64 bit
+      SendResponse(); //send left
+    }
+    void RespondVirtualDistance(int32_t tempDistance){
+      writeCharacters = 4; //set characters to value after adding response header
+      writeBuffer[0] = 'G';
+      writeBuffer[1] = 'V';
+      writeBuffer[2] = 'D';
+      writeBuffer[3] = ':';
+      WriteValueToB64(tempDistance); //convert 1B array to 64 bit
+      SendResponse(); //send left
+    }
+    void RespondRowGap(int32_t tempGap){
+      writeCharacters = 5; //set characters to value after adding response header
+      writeBuffer[0] = 'G';
+      writeBuffer[1] = 'R';
+      writeBuffer[2] = 'G';
+      writeBuffer[3] = 'P';
+      writeBuffer[4] = ':';
+      WriteValueToB64(tempGap); //convert 1B array to 64 bit
+      SendResponse(); //send left
+    }
+    void RespondTriggerQueue(int32_t tempCount){
+      writeCharacters = 4; //set characters to value after adding response header
+      writeBuffer[0] = 'G';
+      writeBuffer[1] = 'T';
+      writeBuffer[2] = 'Q';
+      writeBuffer[3] = ':';
+      WriteValueToB64(tempCount); //convert 1B array to 64 bit
+      SendResponse(); //send left
+    }
+    void RespondValues(const char tempHeader[], uint8_t tempPage, int32_t tempValues[], uint8_t tempCount) { //responds with a list of values, split over multiple lines when needed
+      //each line is: header:page index values, where index is the position of the first value of the line in the list
+      uint8_t tempIndex = 0;
+      while (tempIndex < tempCount) {
+        writeCharacters = 0;
+        for (uint8_t c = 0; tempHeader[c] != 0 && c < 4; c++) { //add header
+          writeBuffer[writeCharacters] = tempHeader[c];
+          writeCharacters++;
+        }
+        writeBuffer[writeCharacters] = ':';
+        writeCharacters++;
+        WriteValueToB64(tempPage);
+        writeBuffer[writeCharacters] = ' ';
+        writeCharacters++;
+        WriteValueToB64(tempIndex);
+        while (tempIndex < tempCount && writeCharacters < 64 - 8) { //add values while a full value still fits (sign, 5 characters, space and end)
+          writeBuffer[writeCharacters] = ' ';
+          writeCharacters++;
+          WriteValueToB64(tempValues[tempIndex]);
+          tempIndex++;
+        }
+        SendResponse();
+      }
+    }
     void RespondWarning(int32_t tempInput) {
       writeCharacters = 5; //set characters to value after adding response header
       writeBuffer[0] = 'G';
@@ -2,6 +2,17 @@
   trigger handles the update for all trigger related functions, it updates and states which triggers are active
   These triggers can then be use by other classes and threads to do things
   Trigger was initially housed in position but moved to it's own program because it also needs to trigger buffer.
+
+  Trigger pins are handled by pin change interrupts, which write down the time and encoder count of the edge, so printing can start
+  relative to the moment of the edge instead of the moment the main loop sees it. Bounces are filtered with a debounce time per pin.
+  The encoder pins are used by the encoder library's interrupts, so these are polled in TriggerUpdate() instead.
+
+  With a start offset set, triggers are not executed right away but put in a queue with the position where the job needs to start
+  (the position at the edge plus the offset). This allows a sensor upstream of the head with several products between sensor and head.
+  Each time a job starts the positions reset, so all pending positions are moved by the same amount.
+
+  Pins set to slot bit mode are not triggers, together they form the number of the buffer slot that is printed on a trigger.
+  The first slot bit pin is bit 0. The slot is read at the moment of the trigger, and kept in the queue with the start position.
 */
 
 #include <Arduino.h>
@@ -13,6 +24,7 @@
 #define TRIGGER_TOGGLE 3
 #define TRIGGER_WHILE_HIGH 4
 #define TRIGGER_WHILE_LOW 5
+#define TRIGGER_SLOT_BIT 6 //not a trigger, the pin is a bit of the buffer slot to print
 
 //trigger pinmode follows arduino values
 #define TRIGGER_FLOATING 0
@@ -29,6 +41,72 @@ uint8_t triggerPinHistory[TRIGGER_PINS] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
 uint8_t triggerPushTrigger = 0; //whether or not to push a message if trigger was triggered
 uint8_t triggerVirtualFlag = 0; //whether a virtual trigger was called
 
+#define TRIGGER_DEBOUNCE_TIME 500 //time in microseconds after an edge in which further changes on the same pin are ignored
+uint8_t triggerPinInterrupt[TRIGGER_PINS]; //whether a pin is handled by an interrupt (1) or polled (0)
+volatile uint8_t triggerPinState[TRIGGER_PINS]; //the debounced state of each pin
+volatile uint8_t triggerPinEdge[TRIGGER_PINS]; //set when a pin had an edge that matches its trigger mode
+volatile uint32_t triggerPinEdgeTime[TRIGGER_PINS]; //when each pin last changed state in microseconds
+volatile uint32_t triggerEventTime; //when the last trigger edge happened in microseconds
+volatile int32_t triggerEventEncoder; //the encoder count at the last trigger edge
+volatile int32_t triggerEventPosition; //the base position in microns at the last trigger edge
+
+#define TRIGGER_QUEUE_SIZE 16 //how many triggers can be pending at the same time
+int32_t triggerStartOffset = 0; //distance in microns between the trigger and the start of the job, 0 starts right away
+int32_t triggerQueuePosition[TRIGGER_QUEUE_SIZE]; //the base positions in microns where the pending triggers start their job
+uint8_t triggerQueueRead = 0; //where the oldest pending trigger is in the queue
+uint8_t triggerQueueCount = 0; //how many triggers are pending
+int8_t triggerQueueSlot[TRIGGER_QUEUE_SIZE]; //the buffer slots of the pending triggers, -1 for no slot select
+
+//one interrupt function per pin, attachInterrupt does not pass which pin changed
+void TriggerInterrupt0() {TriggerEdge(0);}
+void TriggerInterrupt1() {TriggerEdge(1);}
+void TriggerInterrupt2() {TriggerEdge(2);}
+void TriggerInterrupt3() {TriggerEdge(3);}
+void TriggerInterrupt4() {TriggerEdge(4);}
+void TriggerInterrupt5() {TriggerEdge(5);}
+void TriggerInterrupt6() {TriggerEdge(6);}
+void TriggerInterrupt7() {TriggerEdge(7);}
+void TriggerInterrupt8() {TriggerEdge(8);}
+void (*triggerInterrupt[TRIGGER_PINS])() = {TriggerInterrupt0, TriggerInterrupt1, TriggerInterrupt2, TriggerInterrupt3, TriggerInterrupt4,
+                                            TriggerInterrupt5, TriggerInterrupt6, TriggerInterrupt7, TriggerInterrupt8};
+
+void TriggerEdge(uint8_t p) { //handles a change on a pin, called from the pin interrupt
+  uint32_t temp_time = micros();
+  if (TriggerCheckEdge(p, temp_time) == 1) {
+    TriggerCaptureEvent(temp_time);
+    triggerPinEdge[p] = 1;
+  }
+}
+
+uint8_t TriggerCheckEdge(uint8_t p, uint32_t temp_time) { //debounces a pin and returns 1 if it had an edge that matches its trigger mode
+  //only touches the pin state, so it can run with interrupts off
+  uint8_t temp_state = digitalRead(triggerPin[p]);
+  if (temp_state == triggerPinState[p]) return 0; //no change
+  if (temp_time - triggerPinEdgeTime[p] < TRIGGER_DEBOUNCE_TIME) return 0; //too soon after the last change, bounce
+  triggerPinEdgeTime[p] = temp_time;
+  triggerPinState[p] = temp_state;
+
+  //check if the edge matches the trigger mode of the pin
+  uint8_t temp_triggered = 0;
+  if (triggerPinMode[p] == TRIGGER_RISING_EDGE || triggerPinMode[p] == TRIGGER_WHILE_HIGH) {
+    if (temp_state == 1) temp_triggered = 1;
+  }
+  if (triggerPinMode[p] == TRIGGER_FALLING_EDGE || triggerPinMode[p] == TRIGGER_WHILE_LOW) {
+    if (temp_state == 0) temp_triggered = 1;
+  }
+  if (triggerPinMode[p] == TRIGGER_TOGGLE) {
+    temp_triggered = 1;
+  }
+  return temp_triggered;
+}
+
+void TriggerCaptureEvent(uint32_t temp_time) { //writes down the time, encoder count and position of a trigger edge
+  //the encoder read turns interrupts back on, so this is never called with interrupts off
+  triggerEventTime = temp_time;
+  triggerEventEncoder = PositionEncoderRead();
+  triggerEventPosition = PositionGetBasePositionMicronsLive();
+}
+
 
 uint8_t TriggerUpdate() { //updates the trigger and returns a 1 if a new trigger has happened, a 2 if an active trigger is happening (on state change 1 will happen first)
   //look for trigger requirements
@@ -41,45 +119,36 @@ uint8_t TriggerUpdate() { //updates the trigger and returns a 1 if a new trigger
   uint8_t temp_triggered = 0; //if triggered variable
 
   if (temp_active == 1) { //if any pin is set as a trigger
-    uint8_t temp_pin_state[TRIGGER_PINS];
-    for (uint8_t p = 0; p < TRIGGER_PINS; p++) { //get pin values
-      temp_pin_state[p] = digitalRead(triggerPin[p]);
-
-      //check if any state to trigger is met per pin
-      if (triggerPinMode[p] == TRIGGER_RISING_EDGE) { //check rising edge
-        if (temp_pin_state[p] == 1 && triggerPinHistory[p] == 0) {
-          temp_triggered = 1;
-        }
-      }
-      if (triggerPinMode[p] == TRIGGER_FALLING_EDGE) { //check falling edge
-        if (temp_pin_state[p] == 0 && triggerPinHistory[p] == 1) {
-          temp_triggered = 1;
-        }
-      }
-      if (triggerPinMode[p] == TRIGGER_TOGGLE) { //check toggle
-        if (temp_pin_state[p] != triggerPinHistory[p]) {
-          temp_triggered = 1;
-        }
+    for (uint8_t p = 0; p < TRIGGER_PINS; p++) {
+      if (triggerPinMode[p] == TRIGGER_OFF) continue;
+
+      //take the edge of the interrupt and poll the pin in one go, for interrupt pins the poll catches a final state that was filtered out as a bounce
+      uint32_t temp_time = micros();
+      noInterrupts();
+      uint8_t temp_edge = triggerPinEdge[p];
+      triggerPinEdge[p] = 0;
+      uint8_t temp_polled = TriggerCheckEdge(p, temp_time);
+      uint8_t temp_pin_state = triggerPinState[p];
+      interrupts();
+      if (temp_polled == 1) { //the poll found the edge, capture it now that interrupts are on again
+        TriggerCaptureEvent(temp_time);
+        temp_edge = 1;
       }
-      if (triggerPinMode[p] == TRIGGER_WHILE_HIGH) { //check high
-        if (temp_pin_state[p] == 1 && triggerPinHistory[p] == 0) {
-          temp_triggered = 1;
-        }
-        else if (temp_pin_state[p] == 1){
-          temp_triggered = 2; 
-        }
+
+      if (temp_edge == 1) { //an edge matching the mode was seen
+        temp_triggered = 1;
       }
-      if (triggerPinMode[p] == TRIGGER_WHILE_LOW) { //check low
-        if (temp_pin_state[p] == 0 && triggerPinHistory[p] == 1) {
-          temp_triggered = 1;
+      else if (temp_triggered == 0) { //check if a while mode is still active
+        if (triggerPinMode[p] == TRIGGER_WHILE_HIGH && temp_pin_state == 1) {
+          temp_triggered = 2;
         }
-        else if (temp_pin_state[p] == 0){
-          temp_triggered = 2; 
+        if (triggerPinMode[p] == TRIGGER_WHILE_LOW && temp_pin_state == 0) {
+          temp_triggered = 2;
         }
       }
 
       //set history
-      triggerPinHistory[p] = temp_pin_state[p];
+      triggerPinHistory[p] = temp_pin_state;
     }
   }
 
@@ -103,13 +172,103 @@ uint8_t TriggerUpdate() { //updates the trigger and returns a 1 if a new trigger
 
 //send a virtual trigger signal that can be passed on in the trigger update function
 void TriggerVirtual() {
+  TriggerCaptureEvent(micros()); //a virtual trigger happens right now
   triggerVirtualFlag = 1;
 }
 
+uint32_t TriggerGetEventTime() { //returns when the last trigger edge happened in microseconds
+  return triggerEventTime;
+}
+
+int32_t TriggerGetEventEncoder() { //returns the encoder count at the last trigger edge
+  return triggerEventEncoder;
+}
+
+int32_t TriggerGetEventPosition() { //returns the base position in microns at the last trigger edge
+  return triggerEventPosition;
+}
+
+void TriggerSetStartOffset(int32_t temp_offset) { //set the distance in microns between trigger and the start of the job, 0 for right away
+  triggerStartOffset = temp_offset;
+}
+
+int32_t TriggerGetStartOffset() {
+  return triggerStartOffset;
+}
+
+uint8_t TriggerQueueAdd(int32_t temp_position) { //adds a pending trigger that starts at the given position, returns 0 if the queue is full
+  if (triggerQueueCount >= TRIGGER_QUEUE_SIZE) {
+    return 0;
+  }
+  triggerQueuePosition[(triggerQueueRead + triggerQueueCount) % TRIGGER_QUEUE_SIZE] = temp_position;
+  triggerQueueSlot[(triggerQueueRead + triggerQueueCount) % TRIGGER_QUEUE_SIZE] = TriggerGetSlotSelect();
+  triggerQueueCount++;
+  return 1;
+}
+
+uint8_t TriggerQueueReached(int32_t temp_position) { //returns 1 if the oldest pending trigger is reached by the given position
+  if (triggerQueueCount == 0) return 0;
+  int32_t temp_target = triggerQueuePosition[triggerQueueRead];
+  if (triggerStartOffset >= 0 && temp_position >= temp_target) return 1; //the product moves in the direction of the offset
+  if (triggerStartOffset < 0 && temp_position <= temp_target) return 1;
+  return 0;
+}
+
+int8_t TriggerQueueNextSlot() { //returns the buffer slot of the oldest pending trigger, -1 for no slot select
+  if (triggerQueueCount == 0) return -1;
+  return triggerQueueSlot[triggerQueueRead];
+}
+
+int32_t TriggerQueueNext() { //removes the oldest pending trigger from the queue and returns its start position
+  int32_t temp_target = triggerQueuePosition[triggerQueueRead];
+  triggerQueueRead = (triggerQueueRead + 1) % TRIGGER_QUEUE_SIZE;
+  triggerQueueCount--;
+  return temp_target;
+}
+
+void TriggerQueueShift(int32_t temp_change) { //moves all pending triggers by the given amount, used when the position is reset
+  for (uint8_t q = 0; q < triggerQueueCount; q++) {
+    triggerQueuePosition[(triggerQueueRead + q) % TRIGGER_QUEUE_SIZE] += temp_change;
+  }
+}
+
+uint8_t TriggerQueueGetCount() { //returns how many triggers are pending
+  return triggerQueueCount;
+}
+
+void TriggerQueueClear() { //removes all pending triggers
+  triggerQueueCount = 0;
+}
+
+int8_t TriggerGetSlotSelect() { //returns the buffer slot set on the slot bit pins, -1 if no pin is a slot bit
+  int8_t temp_slot = -1;
+  uint8_t temp_bit = 0;
+  for (uint8_t p = 0; p < TRIGGER_PINS; p++) {
+    if (triggerPinMode[p] == TRIGGER_SLOT_BIT) {
+      if (temp_slot < 0) temp_slot = 0;
+      if (triggerPinState[p] == 1) temp_slot |= 1 << temp_bit;
+      temp_bit++;
+    }
+  }
+  return temp_slot;
+}
 
 void TriggerSetPinMode(uint8_t temp_pin, uint8_t temp_mode) {
+  if (temp_mode > TRIGGER_SLOT_BIT) temp_mode = TRIGGER_OFF; //unknown modes turn the pin off
   if (temp_pin < TRIGGER_PINS) { //limit the input pins
+    if (triggerPinInterrupt[temp_pin] == 1) { //stop the old interrupt
+      detachInterrupt(triggerPin[temp_pin]);
+      triggerPinInterrupt[temp_pin] = 0;
+    }
+    noInterrupts();
     triggerPinMode[temp_pin] = temp_mode;
+    triggerPinState[temp_pin] = digitalRead(triggerPin[temp_pin]); //start from the current state, so setting a mode is no edge
+    triggerPinEdge[temp_pin] = 0;
+    interrupts();
+    if (temp_mode != TRIGGER_OFF && triggerPin[temp_pin] != POSITION_ENCODER_PIN1 && triggerPin[temp_pin] != POSITION_ENCODER_PIN2) {
+      attachInterrupt(triggerPin[temp_pin], triggerInterrupt[temp_pin], CHANGE); //encoder pins keep being polled
+      triggerPinInterrupt[temp_pin] = 1;
+    }
   }
 }
 
@@ -134,3 +293,17 @@ void TriggerSetTriggerPush(uint8_t temp_mode) {
   temp_mode = constrain(temp_mode, 0, 1);
   triggerPushTrigger = temp_mode;
 }
+
+uint8_t TriggerGetPinMode(uint8_t temp_pin) { //returns the trigger mode of a pin
+  if (temp_pin < TRIGGER_PINS) return triggerPinMode[temp_pin];
+  return TRIGGER_OFF;
+}
+
+uint8_t TriggerGetResistor(uint8_t temp_pin) { //returns the resistor setting of a pin
+  if (temp_pin < TRIGGER_PINS) return triggerPinResistor[temp_pin];
+  return TRIGGER_FLOATING;
+}
+
+uint8_t TriggerGetTriggerPush() { //returns whether a message is pushed on a trigger
+  return triggerPushTrigger;
+}
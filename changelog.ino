@@ -15,3 +15,32 @@
 
 //V4.01.07:
 //EEPROM functions EepromCheckSaved() and EepromSetSaved() were added to verify if HP45 standalone has saved in EEPROM or not
+
+//V4.01.08:
+//Virtual position now follows a trapezoidal motion profile with acceleration (SVA, GVA) and an optional end distance (SVD, GVD), integrated incrementally in integer math
+//Added buffer update mode (BUPM) where a timer interrupt advances the buffer on the live encoder position, and a side now advances as many lines as were passed in one update
+//Row gap is now a runtime setting in nanometers (SRGP, GRGP) that is saved to EEPROM, row positions are calculated in fixed point without floats
+//Added a row gap calibration pattern (RGCP) and a select command (RGCS) to apply the best patch
+//Trigger pins now use pin change interrupts with a time based debounce, the time and encoder count of the edge are captured and the position is reset relative to the edge. The 1ms trigger update limit was removed
+//Added a trigger queue with a start offset (STOF, GTQ, CTQ), triggers start their job once the product moved the offset from the sensor to the head
+//Added a cycle counter profiler (Profiler.h) for all stages of UpdateAll, SetBurst and Burst, with a binary dump (#PRF) and reset (#PRR). Only built in with PROFILER_ENABLED
+//Added burst statistics (GBST, RBST): burst lateness and misses, buffer underruns, skipped lines and overshoot at line switch
+//The sense lines (TSR, 10X, logic and head voltage) are now sampled in the background between bursts and filtered, UpdateStatus uses these values and also checks while printing
+//Fixed the head temperature warning being written to the error list
+//Temperature and voltage conversions are now done in integers (temperature in .1C, voltage in millivolts), GetTemperature now restores the enable state of the head
+//Added pulse width compensation, the DMA timer period follows a table by head temperature and voltage (SPWC, SPWT, GPWD), and an optional idle preheat (SIPH)
+//Added a firing limit per nozzle, nozzles that fire again within the minimum fire period set an overspeed warning or have their dots dropped (SMFP, SFLM), GMSV reports the maximum safe velocity
+//Preheat and prime now fire as a pulse train from the DMA interrupt and return right away, the main loop keeps running (GPTS, PTST)
+//Added spitting, nozzles that were not fired for the spit time get a few drops outside the print window, within a budget (SSPT, SSPB, GSPS)
+//Added drop counters per nozzle using bit sliced counters, with job totals, estimated ink volume and lifetime totals saved to EEPROM (GDRC, RDRC, SDRC)
+//Added dead nozzle compensation, drops of nozzles found dead by the printhead test move to a working neighbour in the same row (SNCM, GNCM)
+//The printhead test now goes through the addresses in order and sets the primitives with port writes, added a quick test that tests one address at a time while idle (STQT)
+//Settings are saved in a versioned, CRC16 checked config struct (ESAV/ELOD). A valid config skips the boot delay, the old row gap location is still read when no config was saved
+//Added a job store in the top of the program flash, jobs are recorded from SBR lines once and printed from flash on each trigger without a host (PRMD, JSEL, JREC, JERS, GJOB)
+//Added an SD card job player, job files are read ahead in sector aligned blocks with 2 blocks and added to the buffer in bulk (SDOP, GSDS, PRMD 2)
+//The buffer can be split in up to 8 slots with their own image and mode, selected by command or by slot bit trigger pins at each trigger (BSLN, BSLS, GBSL)
+//Added buffer compression, lines refer to a pool of bursts and repeated lines share a burst, so 4 times the lines fit in the same memory (BCMP, GBCM)
+//Added buffer seek, static and looping jobs can resume at any position with a binary search over the line positions (BSEK)
+//Added raster lines, SBN lines get their position from the raster start, LPI and direction, and can repeat a line n times (SBN, SRST, SLPI, SRDR, GRST)
+//Added step and repeat, in looping mode the pattern repeats every pitch with its positions moved, each side wraps on its own without a trigger (SRPP, SRPC, GRPS)
+//DPI is no longer rounded to 600/n, any DPI from 1 to 600 is spread over the nozzles with a pixel to nozzle table that is built when the DPI is set (SDP, SDPI)
@@ -0,0 +1,77 @@
+/*
+  Compares the integer sense line conversions of HeadSense.h with the float formulas they replaced, over the full 13 bit range.
+  Build and run on a computer from the sketch folder:
+  g++ -O2 -o HeadSenseTest test/HeadSenseTest.cpp && ./HeadSenseTest
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../HeadSense.h"
+
+#define TEMPERATURE_TOLERANCE 2 //the largest allowed difference in .1C
+#define VOLTAGE_TOLERANCE 1 //the largest allowed difference in millivolts
+
+static float FloatResistance(int32_t tempRaw) { //the old divider resistance in ohm
+  float tempFCalc = float(tempRaw);
+  tempFCalc /= 8192; //get the fraction
+  tempFCalc *= 3.3; //get the voltage
+  return (tempFCalc * 330.0) / (3.3 - tempFCalc);
+}
+
+static uint32_t FloatVoltage(int32_t tempV) { //the old voltage conversion in millivolts
+  float tempFCalc = float(tempV);
+  tempFCalc /= 8192.0;
+  tempFCalc *= 3.3;
+  float tempFCalc2 = 10000.0 + 1200.0;
+  tempFCalc2 /= 1200.0;
+  tempFCalc = tempFCalc2 * tempFCalc;
+  tempFCalc *= 1000.0;
+  return long(tempFCalc);
+}
+
+int main() {
+  static float tempRes[8192];
+  static uint8_t tempValid[8192]; //0 out of range, 1 in range, 2 within .1 ohm of a limit, where rounding decides
+  for (int32_t r = 0; r < 8192; r++) {
+    tempRes[r] = FloatResistance(r);
+    tempValid[r] = (tempRes[r] >= 150.0 && tempRes[r] <= 500.0) ? 1 : 0;
+    if (fabs(tempRes[r] - 150.0) <= 0.1 || fabs(tempRes[r] - 500.0) <= 0.1) tempValid[r] = 2;
+  }
+
+  uint32_t tempFails = 0;
+  int32_t tempMaxDiff = 0;
+  uint32_t tempCompared = 0;
+  for (int32_t t = 0; t < 8192; t++) { //TSR
+    for (int32_t x = 0; x < 8192; x++) { //10X
+      int32_t tempInt = HeadSenseTemperature(x, t);
+      if (tempValid[t] == 2 || tempValid[x] == 2) continue; //either result is right on a limit
+      if (tempValid[t] == 0 || tempValid[x] == 0) { //the old formula gave no temperature
+        if (tempInt != -2) tempFails++;
+        continue;
+      }
+      int32_t tempFloat = long((1.1 * (tempRes[t] - tempRes[x]) + 10.0) * 10.0);
+      int32_t tempDiff = abs(tempInt - tempFloat);
+      if (tempDiff > tempMaxDiff) tempMaxDiff = tempDiff;
+      if (tempDiff > TEMPERATURE_TOLERANCE) tempFails++;
+      tempCompared++;
+    }
+  }
+  printf("temperature: %u pairs compared, largest difference %d (.1C), %u failed\n", tempCompared, tempMaxDiff, tempFails);
+
+  uint32_t tempVoltageFails = 0;
+  int32_t tempVoltageMaxDiff = 0;
+  for (int32_t v = 0; v < 8192; v++) {
+    int32_t tempDiff = abs(int32_t(HeadSenseVoltage(v)) - int32_t(FloatVoltage(v)));
+    if (tempDiff > tempVoltageMaxDiff) tempVoltageMaxDiff = tempDiff;
+    if (tempDiff > VOLTAGE_TOLERANCE) tempVoltageFails++;
+  }
+  printf("voltage: largest difference %d mV, %u failed\n", tempVoltageMaxDiff, tempVoltageFails);
+
+  if (tempFails != 0 || tempVoltageFails != 0) {
+    printf("FAIL\n");
+    return 1;
+  }
+  printf("PASS\n");
+  return 0;
+}
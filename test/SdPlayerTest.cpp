@@ -0,0 +1,157 @@
+/*
+  Plays a job file through the block logic of SdBlocks.h on a computer, with a regular file in place of the SD card and a
+  simulated buffer that only takes a few lines at a time. Checks that every line arrives once and in order, and measures
+  how fast lines move through the player. Without a file a test job is made, with cut off and broken versions of it.
+  Build and run on a computer from the sketch folder:
+  g++ -O2 -o SdPlayerTest test/SdPlayerTest.cpp && ./SdPlayerTest [JOBnnn.HPJ]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../SdBlocks.h"
+
+#define TEST_LINES 100003 //not a multiple of the block, so the last block is partial
+#define TEST_BUFFER_LINES 4000 //about the lines of the buffer
+
+static FILE *testFile;
+static SdBlocks testPlayer;
+static uint8_t *testExpected; //all lines of the file, to compare with
+static int32_t testExpectedLines;
+static int32_t testBufferLines; //lines in the simulated buffer
+static int32_t testChecked; //lines that arrived in the buffer
+static int32_t testErrors;
+static uint32_t testAddCalls;
+
+static int32_t TestRead(uint8_t *tempData, int32_t tempBytes) {
+  return fread(tempData, 1, tempBytes, testFile);
+}
+
+static int32_t TestAdd(const uint8_t *tempLines, int32_t tempCount) { //takes as many lines as fit, like AddBulk
+  testAddCalls++;
+  int32_t tempSpace = TEST_BUFFER_LINES - testBufferLines;
+  if (tempCount > tempSpace) tempCount = tempSpace;
+  for (int32_t l = 0; l < tempCount; l++) {
+    if (testChecked >= testExpectedLines || memcmp(tempLines + l * SD_LINE_SIZE, testExpected + testChecked * SD_LINE_SIZE, SD_LINE_SIZE) != 0) {
+      if (testErrors < 10) printf("line %d is not what the file holds\n", testChecked);
+      testErrors++;
+    }
+    testChecked++;
+  }
+  testBufferLines += tempCount;
+  return tempCount;
+}
+
+static void TestMakeJob(const char *tempName, int32_t tempHeaderLines, int32_t tempFileLines, uint8_t tempBroken) { //writes a job file with a number of lines
+  FILE *tempFile = fopen(tempName, "wb");
+  uint8_t tempHeader[SD_HEADER_SIZE];
+  memset(tempHeader, 0, sizeof(tempHeader));
+  memcpy(tempHeader, "HP45", 4);
+  tempHeader[4] = 1;
+  tempHeader[6] = SD_LINE_SIZE;
+  if (tempBroken == 1) tempHeader[4] = 2; //a version that is not known
+  memcpy(tempHeader + 8, &tempHeaderLines, 4);
+  fwrite(tempHeader, 1, SD_HEADER_SIZE, tempFile);
+  uint8_t tempLine[SD_LINE_SIZE];
+  for (int32_t l = 0; l < tempFileLines; l++) {
+    int32_t tempPosition = l * 42;
+    memcpy(tempLine, &tempPosition, 4);
+    for (int32_t b = 4; b < SD_LINE_SIZE; b++) {
+      tempLine[b] = uint8_t(l * 7 + b * 13);
+    }
+    fwrite(tempLine, 1, SD_LINE_SIZE, tempFile);
+  }
+  fclose(tempFile);
+}
+
+static int32_t TestPlay(const char *tempName, int32_t tempDrain, uint8_t tempReadAhead, int32_t tempWantLines) { //plays a file, the buffer prints a number of lines each update, returns 1 if it passed
+  testFile = fopen(tempName, "rb");
+  if (testFile == NULL) {
+    printf("%s can not be opened\n", tempName);
+    return 0;
+  }
+  uint8_t tempHeader[SD_HEADER_SIZE];
+  fseek(testFile, 0, SEEK_END);
+  int32_t tempSize = ftell(testFile);
+  fseek(testFile, 0, SEEK_SET);
+  int32_t tempLines = -1;
+  if (fread(tempHeader, 1, SD_HEADER_SIZE, testFile) == SD_HEADER_SIZE) tempLines = SdBlocksHeaderLines(tempHeader, tempSize);
+  if (tempLines != tempWantLines) {
+    printf("%s: header gives %d lines, expected %d\n", tempName, tempLines, tempWantLines);
+    fclose(testFile);
+    return 0;
+  }
+  if (tempLines < 0) { //not a job, nothing to play
+    fclose(testFile);
+    return 1;
+  }
+
+  //load all lines to compare with
+  testExpected = (uint8_t *)malloc(size_t(tempLines) * SD_LINE_SIZE + 1);
+  testExpectedLines = fread(testExpected, SD_LINE_SIZE, tempLines, testFile);
+  fseek(testFile, SD_HEADER_SIZE, SEEK_SET);
+  testBufferLines = 0;
+  testChecked = 0;
+  testErrors = 0;
+  testAddCalls = 0;
+  testPlayer.fileLines = tempLines;
+
+  struct timespec tempStart, tempEnd;
+  clock_gettime(CLOCK_MONOTONIC, &tempStart);
+  SdBlocksStart(&testPlayer, TestRead);
+  uint32_t tempUpdates = 0;
+  while (testPlayer.playing == 1) {
+    SdBlocksUpdate(&testPlayer, TestAdd, TestRead, (tempReadAhead == 1 || (tempUpdates & 7) == 0) ? 1 : 0);
+    testBufferLines -= (testBufferLines < tempDrain) ? testBufferLines : tempDrain; //the head prints a few lines
+    tempUpdates++;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &tempEnd);
+  double tempSeconds = double(tempEnd.tv_sec - tempStart.tv_sec) + double(tempEnd.tv_nsec - tempStart.tv_nsec) / 1e9;
+
+  if (testChecked != tempLines) {
+    printf("%s: %d of %d lines arrived\n", tempName, testChecked, tempLines);
+    testErrors++;
+  }
+  printf("%s: %d lines, drain %d, read ahead %s, %u updates, %u adds, %.1f MB/s\n", tempName, tempLines, tempDrain,
+         tempReadAhead == 1 ? "always" : "sometimes", tempUpdates, testAddCalls,
+         tempSeconds > 0 ? (double(tempLines) * SD_LINE_SIZE) / (tempSeconds * 1e6) : 0.0);
+  free(testExpected);
+  fclose(testFile);
+  return testErrors == 0;
+}
+
+int main(int argc, char **argv) {
+  int32_t tempFails = 0;
+  if (argc > 1) { //play a given job, for benchmarking
+    FILE *tempFile = fopen(argv[1], "rb");
+    if (tempFile == NULL) {
+      printf("%s can not be opened\n", argv[1]);
+      return 1;
+    }
+    uint8_t tempHeader[SD_HEADER_SIZE];
+    fseek(tempFile, 0, SEEK_END);
+    int32_t tempSize = ftell(tempFile);
+    fseek(tempFile, 0, SEEK_SET);
+    int32_t tempLines = -1;
+    if (fread(tempHeader, 1, SD_HEADER_SIZE, tempFile) == SD_HEADER_SIZE) tempLines = SdBlocksHeaderLines(tempHeader, tempSize);
+    fclose(tempFile);
+    if (TestPlay(argv[1], 1000000, 1, tempLines) == 0) tempFails++;
+  }
+  else {
+    const char *tempName = "SdPlayerTest.hpj";
+    TestMakeJob(tempName, TEST_LINES, TEST_LINES, 0);
+    if (TestPlay(tempName, 1000000, 1, TEST_LINES) == 0) tempFails++; //buffer never full, throughput of the block logic
+    if (TestPlay(tempName, 3, 1, TEST_LINES) == 0) tempFails++; //buffer full most of the time
+    if (TestPlay(tempName, 3, 0, TEST_LINES) == 0) tempFails++; //read ahead held back most updates, as while printing
+    if (TestPlay(tempName, 40, 0, TEST_LINES) == 0) tempFails++; //held back and the buffer runs dry
+    TestMakeJob(tempName, TEST_LINES, 1000, 0); //cut off file, the header promises more lines than there are
+    if (TestPlay(tempName, 5, 1, 1000) == 0) tempFails++;
+    TestMakeJob(tempName, 0, 0, 0); //empty job
+    if (TestPlay(tempName, 5, 1, 0) == 0) tempFails++;
+    TestMakeJob(tempName, 10, 10, 1); //unknown version
+    if (TestPlay(tempName, 5, 1, -1) == 0) tempFails++;
+    remove(tempName);
+  }
+  printf("%s\n", tempFails == 0 ? "PASS" : "FAIL");
+  return tempFails == 0 ? 0 : 1;
+}